@@ -45,14 +45,56 @@
  *	  Some Notes:
  *	  	- nice implementaion example: http://ftp.netbsd.org/pub/NetBSD/NetBSD-current/src/external/bsd/wpa/dist/src/crypto/tls_openssl.c
  *	  	- man SSL_CTX_set_tlsext_status_cb
+ *	- added Chrome trace-event output (--trace), 18.10.2026
+ *	- added daemon mode with a Unix socket job interface, 18.10.2026
+ *	- added Prometheus metrics (--metrics, --metrics-file), 18.10.2026
+ *	- added libsslscan, the scanning core as a reentrant library, 18.10.2026
+ *	- STARTTLS dialogues are line oriented and non-blocking, 18.10.2026
+ *	- added SMTP PIPELINING of EHLO and STARTTLS (--smtp-pipelining), 18.10.2026
+ *	- the trusted CAs are loaded once into a shared store (--capath), 18.10.2026
+ *	- verify results and rendered certificates are cached by fingerprint, 18.10.2026
+ *	- certificates are decoded once for text / XML renderers (--quiet), 18.10.2026
+ *	- probe results carry cipher ids and timings, counting-only output (--count), 18.10.2026
+ *	- added certificate only scans (--cert-only) and parallel targets (--parallel), 18.10.2026
+ *	- added a cipher class policy audit mode (--policy), 18.10.2026
+ *	- connect, handshake and read timeouts adapt to the round trip time, 18.10.2026
+ *	- failed probes are classified, retried with backoff and no longer end the scan, 18.10.2026
+ *	- added source address pools (--source) and abortive close (--abortive-close), 18.10.2026
+ *	- added a batched reachability sweep of --targets (--sweep), io_uring or epoll, 18.10.2026
+ *	- one cipher catalog per process, per-scan allocations come from an arena, 18.10.2026
+ *	- output files ending in .gz or .zst are compressed (--compress-level), 18.10.2026
+ *	- added a baseline mode that reports only what changed (--baseline), 18.10.2026
+ *	- added TLS 1.3 (--tls1_3), its suites are found by elimination, 18.10.2026
+ *	- added key exchange group and signature algorithm enumeration (--groups, --sigalgs), 18.10.2026
+ *	- SSLv2 and SSLv3 are detected with raw records if OpenSSL lacks them, 18.10.2026
+ *	- the HTTP status (--http) is asked once per host, not per cipher, 18.10.2026
+ *	- added a handshake throughput load test of the accepted ciphers (--loadtest), 18.10.2026
+ *	- added session ID and ticket resumption tests (--resumption), 18.10.2026
  */
 
 // Includes...
+#define _GNU_SOURCE
 #include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 #include <openssl/pkcs12.h>
@@ -60,6 +102,16 @@
 #include <openssl/x509v3.h>
 #include <openssl/tls1.h>
 #include <openssl/ocsp.h>
+#include <openssl/sha.h>
+#include <zlib.h>
+#include "sslscan.h"
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef WITH_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
 
 // Defines...
 #define false 0
@@ -69,19 +121,125 @@
 #define mode_version 1
 #define mode_single 2
 #define mode_multiple 3
+#define mode_daemon 4
 
 #define BUFFERSIZE 1024
 
-// Bitmask for ssl versions
-#define ssl_none 0x00
-#define ssl_v2   0x01
-#define ssl_v3   0x02
-#define ssl_all  0x03 // 0x02+0x01
-#define tls_v1   0x04
-#define tls_v1_1 0x08
-#define tls_v1_2 0x10
-#define tls_all  0x1c // 0x10+0x08+0x04
-#define ssl_tls_all  0xff
+#define default_cafile "/etc/ssl/certs/ca-certificates.crt"
+
+// STARTTLS dialogue protocols
+#define starttls_smtp 1
+#define starttls_ftp 2
+#define starttls_pop3 3
+#define starttls_imap 4
+
+// STARTTLS dialogue status
+#define starttls_wait 0
+#define starttls_done 1
+#define starttls_failed 2
+
+// SMTP capabilities (EHLO keywords)
+#define smtp_pipelining 0x01
+
+// Certificate caches (entries, direct mapped by SHA-256 fingerprint)
+#define certificate_cache_size 256
+
+// Most worker processes for --parallel, output buffer of a worker
+#define parallel_max 256
+#define parallel_buffer (1024 * 1024)
+
+// Load test (--loadtest): default connections, most accepted ciphers
+// driven, most handshake latencies kept per cipher
+#define loadtest_connections 8
+#define loadtest_ciphers_max 256
+#define loadtest_samples_max (1024 * 1024)
+
+// Baseline (--baseline): hash buckets, summary counters
+#define baseline_buckets 4096
+#define baseline_unchanged 0
+#define baseline_changed 1
+#define baseline_new 2
+
+// Compressed output files: format, uncompressed size of a frame
+#define compress_none 0
+#define compress_gzip 1
+#define compress_zstd 2
+#define compress_frame (1024 * 1024)
+
+// Most handshakes to expand one accepted policy class
+#define policy_handshakes_max 64
+
+// TLS 1.3 suites offered (all that are defined), most of them in the catalog
+#define tls13_suites "TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:TLS_AES_128_CCM_SHA256:TLS_AES_128_CCM_8_SHA256"
+#define tls13_suites_max 16
+
+// Key exchange groups and signature algorithms offered (the ones OpenSSL
+// knows), protocols they are enumerated for, most handshakes for a list
+#define exchange_groups "X25519:X448:P-256:P-384:P-521:ffdhe2048:ffdhe3072:ffdhe4096:ffdhe6144:ffdhe8192"
+#define exchange_signatures "ed25519:ed448:ECDSA+SHA256:ECDSA+SHA384:ECDSA+SHA512:RSA-PSS+SHA256:RSA-PSS+SHA384:RSA-PSS+SHA512:RSA+SHA256:RSA+SHA384:RSA+SHA512:ECDSA+SHA224:RSA+SHA224:ECDSA+SHA1:RSA+SHA1"
+#define exchange_versions 4
+#define exchange_handshakes_max 32
+
+// Pairs of a full and a resumed handshake per resumption method
+#define resumption_samples 3
+
+// SSLv2 and SSLv3 are detected with raw records if OpenSSL can not speak
+// them: most ciphers of a table, largest reply read (a SSLv2 record)
+#ifdef DISABLE_SSLv2
+#define LEGACY_SSLv2
+#endif
+#ifdef OPENSSL_NO_SSL3_METHOD
+#define LEGACY_SSLv3
+#endif
+#define legacy_ciphers_max 64
+#define legacy_reply_max (2 + 32767)
+
+// --http asks once per host: longest status kept, accepted connections
+// the request is tried on before the host is left without a status
+#define http_status_max 64
+#define http_attempts_max 2
+
+// Timeouts (microseconds), derived from the round trip time of a host once
+// a connect has been timed. Handshakes and reads get several round trips
+#define timeout_initial 10000000
+#define timeout_rto_min 1000000
+#define timeout_rto_max 60000000
+#define timeout_read_rtos 4
+#define timeout_read_min 5000000
+
+// Retries of transient failures: per probe, per host, backoff (microseconds)
+// and consecutive failed probes after which a host is given up
+#define retry_attempts 3
+#define retry_budget 32
+#define retry_backoff 200000
+#define retry_backoff_max 3200000
+#define failure_abandon 4
+
+// Per-scan arena: size of a block, alignment of allocations
+#define arena_block 4096
+#define arena_align 16
+
+// Interned strings (hash buckets)
+#define intern_buckets 64
+
+// Most local source addresses (--source)
+#define source_max 64
+
+// Reachability sweep (--sweep): endpoints per batch, time for a batch
+// (microseconds), epoll events per wait, largest ClientHello
+#define sweep_width_max 4096
+#define sweep_timeout 5000000
+#define sweep_events 256
+#define sweep_hello 4096
+
+// Sweep slot states and io_uring request types
+#define sweep_socket 0
+#define sweep_connect 1
+#define sweep_send 2
+#define sweep_receive 3
+#define sweep_cancel 4
+#define sweep_close 5
+#define sweep_user(slot, type) (((unsigned long long)(slot) << 3) | (type))
 
 // Colour Console Output...
 #if !defined(__WIN32__)
@@ -108,23 +266,99 @@ const char *program_banner = "                   _\n"
 const char *program_version = "sslscan version 1.9";
 const char *xml_version = "1.9";
 
+const char *phaseNames[phase_count] = { "connect", "starttls", "handshake", "http", "certificate", "host" };
+
+// Latency histogram bucket bounds (microseconds)
+const long long metricsBuckets[metrics_buckets] = { 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000 };
+
+// Trace timeline rows handed out in this process (atomic)
+int traceThreads = 0;
+
+// Cipher catalog shared by every handle, only ever appended to (under catalogLock)
+struct sslCipher *cipherCatalog = 0;
+int catalogVersions = ssl_none;
+int catalogLock = 0;
+
+// Interned strings of this process, never freed (under internLock)
+struct internedString *internedStrings[intern_buckets];
+int internLock = 0;
+
 
 struct sslCipher
 {
 	// Cipher Properties...
 	const char *name;
-	char *version;
+	unsigned long id;
+	const char *version;
 	int bits;
-	char description[512];
 	const SSL_METHOD *sslMethod;
+	int sslVersion;
 	struct sslCipher *next;
 };
 
+// A SSLv2 or SSLv3 cipher of the raw record detection...
+struct legacyCipher
+{
+	unsigned long id;
+	const char *name;
+	int bits;
+};
+
+struct internedString
+{
+	struct internedString *next;
+	char string[];
+};
+
+struct arenaBlock
+{
+	// Block of a per-scan arena...
+	struct arenaBlock *next;
+	size_t size;
+	size_t used;
+	char data[] __attribute__((aligned(arena_align)));
+};
+
+struct sweepSlot
+{
+	// Endpoint of a sweep...
+	int socketDescriptor;
+	int state;
+	unsigned char reply[5];
+};
+
+struct policyClass
+{
+	// Class Properties...
+	char name[64];
+	char ciphers[512];
+	int sslVersion;
+	struct policyClass *next;
+};
+
+struct sslContext
+{
+	// Context Properties...
+	const SSL_METHOD *sslMethod;
+	int verify;
+	SSL_CTX *ctx;
+	struct sslContext *next;
+};
+
+struct verifyCacheEntry
+{
+	// SHA-256 over the fingerprints of the presented chain...
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	long verifyResult;
+	int used;
+};
+
 struct sslCheckOptions
 {
-	// Program Options...
-	char host[512];
-	char cafile[512];
+	// Program Options (host in the arena, the others interned)...
+	const char *host;
+	const char *cafile;
+	const char *capath;
 	int port;
 	int noFailed;
 	int esmtps;
@@ -135,80 +369,325 @@ struct sslCheckOptions
 	int sslVersion;
 	int targets;
 	int pout;
+	int quiet;
+	int count;
 	int sslbugs;
 	int http;
 	int sniEnable;
-	char sniServername[512];
+	const char *sniServername;
 	int OCSPStatusRequest;
+	int smtpPipelining;
+	int certOnly;
+	int groups;
+	int sigalgs;
+	int resumption;
+
+	// SMTP capabilities of the current host...
+	int smtpCapabilities;
+
+	// HTTP status of the current host (--http, empty until answered)...
+	char httpStatus[http_status_max];
+	int httpCode;
+	int httpAttempts;
+
+	// Preferred TLS 1.3 suite of the current host (the first one accepted)...
+	struct sslCipherResult tls13Preferred;
+
+	// Preferred SSLv2 and SSLv3 ciphers of the current host (raw records)...
+	struct sslCipherResult legacyPreferred[2];
+
+	// Accepted cipher of the current host for the key exchange enumeration,
+	// one per protocol of exchangeVersions (0 if none)...
+	const char *exchangeCiphers[exchange_versions];
+
+	// Protocols that accepted a cipher on the current host...
+	int acceptedVersions;
+
+	// Round trip estimate of the current host (microseconds, 0 if none)...
+	long long smoothedRtt;
+	long long rttVariance;
+
+	// Failure class of the last connect, retries left for the current host...
+	int failure;
+	int retryBudget;
+	unsigned int retrySeed;
+
+	// Connection Options...
+	struct in_addr sourceAddresses[source_max];
+	int sourceCount;
+	int sourceNext;
+	int abortiveClose;
+	int openSockets;
 
 	// File Handles...
 	FILE *xmlOutput;
+	FILE *traceOutput;
+
+	// Trace State...
+	int traceThread;
+
+	// Metrics...
+	struct scanMetrics *metrics;
+
+	// Result Callbacks...
+	struct sslScanCallbacks callbacks;
+	void *userData;
 
 	// TCP Connection Variables...
-	struct hostent *hostStruct;
 	struct sockaddr_in serverAddress;
 
+	// Allocations of the current scan...
+	struct arenaBlock *arena;
+
 	// SSL Variables...
-	SSL_CTX *ctx;
-	struct sslCipher *ciphers;
+	X509_STORE *trustStore;
+	struct verifyCacheEntry *verifyCache;
+	struct sslContext *contexts;
+	struct policyClass *policy;
 	char *clientCertsFile;
 	char *privateKeyFile;
 	char *privateKeyPassword;
 };
 
 
-// Adds Ciphers to the Cipher List structure
-int populateCipherList(struct sslCheckOptions *options, const SSL_METHOD *sslMethod)
+// Update a metrics counter (atomic, safe across forked processes)...
+#define metricsAdd(options, counter, value) do { if ((options)->metrics != 0) __sync_fetch_and_add(&(options)->metrics->counter, (value)); } while (0)
+
+
+// Report an error through the error callback...
+void scanError(struct sslCheckOptions *options, const char *format, ...)
+{
+	// Variables...
+	char message[BUFFERSIZE];
+	va_list arguments;
+
+	if (options->callbacks.error == 0)
+		return;
+
+	va_start(arguments, format);
+	vsnprintf(message, sizeof(message), format, arguments);
+	va_end(arguments);
+	options->callbacks.error(options->userData, message);
+}
+
+
+// Allocate from the arena of the current scan (0 if out of memory)...
+//   Everything a scan allocates for itself comes from here and is
+//   released in one go by arenaRelease() when the host is done.
+void *arenaAlloc(struct sslCheckOptions *options, size_t size)
+{
+	// Variables...
+	struct arenaBlock *block = options->arena;
+	size_t blockSize;
+	void *pointer;
+
+	size = (size + arena_align - 1) & ~(size_t)(arena_align - 1);
+	if ((block == 0) || (block->used + size > block->size))
+	{
+		blockSize = (size > arena_block) ? size : arena_block;
+		block = malloc(sizeof(struct arenaBlock) + blockSize);
+		if (block == NULL)
+			return NULL;
+		block->next = options->arena;
+		block->size = blockSize;
+		block->used = 0;
+		options->arena = block;
+	}
+	pointer = block->data + block->used;
+	block->used += size;
+	return pointer;
+}
+
+
+// Copy a string into the arena of the current scan ("" if out of memory)...
+const char *arenaString(struct sslCheckOptions *options, const char *string)
+{
+	// Variables...
+	size_t length = strlen(string);
+	char *copy = arenaAlloc(options, length + 1);
+
+	if (copy == NULL)
+		return "";
+	memcpy(copy, string, length + 1);
+	return copy;
+}
+
+
+// Release the arena of the current scan...
+//   An idle handle holds no arena memory.
+void arenaRelease(struct sslCheckOptions *options)
+{
+	// Variables...
+	struct arenaBlock *block;
+
+	while (options->arena != 0)
+	{
+		block = options->arena->next;
+		free(options->arena);
+		options->arena = block;
+	}
+	options->host = "";
+}
+
+
+// Intern a string, equal strings share one copy for the life of the process...
+//   For option values many handles have in common (0 if out of memory).
+const char *internString(const char *string)
+{
+	// Variables...
+	struct internedString *interned;
+	unsigned int hash = 5381;
+	const char *character;
+
+	for (character = string; *character != 0; character++)
+		hash = hash * 33 + (unsigned char)*character;
+	hash %= intern_buckets;
+
+	while (__sync_lock_test_and_set(&internLock, 1) != 0)
+		sched_yield();
+	for (interned = internedStrings[hash]; interned != 0; interned = interned->next)
+	{
+		if (strcmp(interned->string, string) == 0)
+			break;
+	}
+	if (interned == 0)
+	{
+		interned = malloc(sizeof(struct internedString) + strlen(string) + 1);
+		if (interned != NULL)
+		{
+			strcpy(interned->string, string);
+			interned->next = internedStrings[hash];
+			internedStrings[hash] = interned;
+		}
+	}
+	__sync_lock_release(&internLock);
+
+	return (interned != 0) ? interned->string : 0;
+}
+
+
+// Get the version bitmask of a SSL/TLS protocol method...
+int sslMethodVersion(const SSL_METHOD *sslMethod)
+{
+#ifndef DISABLE_SSLv2
+	if (sslMethod == SSLv2_client_method())
+		return ssl_v2;
+#endif
+#ifndef OPENSSL_NO_SSL3_METHOD
+	if (sslMethod == SSLv3_client_method())
+		return ssl_v3;
+#endif
+	if (sslMethod == TLSv1_client_method())
+		return tls_v1;
+	else if (sslMethod == TLSv1_1_client_method())
+		return tls_v1_1;
+	else if (sslMethod == TLSv1_2_client_method())
+		return tls_v1_2;
+	return ssl_none;
+}
+
+
+// Get the client method of a version bitmask (SSLv23 for none or several)...
+const SSL_METHOD *sslVersionMethod(int sslVersion)
+{
+#ifndef DISABLE_SSLv2
+	if (sslVersion == ssl_v2)
+		return SSLv2_client_method();
+#endif
+#ifndef OPENSSL_NO_SSL3_METHOD
+	if (sslVersion == ssl_v3)
+		return SSLv3_client_method();
+#else
+	// Only raw records speak SSLv3, there is no method
+	if (sslVersion == ssl_v3)
+		return NULL;
+#endif
+	if (sslVersion == tls_v1)
+		return TLSv1_client_method();
+	else if (sslVersion == tls_v1_1)
+		return TLSv1_1_client_method();
+	else if (sslVersion == tls_v1_2)
+		return TLSv1_2_client_method();
+#ifdef TLS1_3_VERSION
+	// TLS 1.3 has no method of its own, the version is set per connection
+	else if (sslVersion == tls_v1_3)
+		return TLS_client_method();
+#endif
+	return SSLv23_client_method();
+}
+
+
+// Adds the ciphers of a protocol to the catalog (called under catalogLock)
+//   The entries are filled in before they are linked, handles that are
+//   walking the catalog see either none or all of them.
+int populateCipherList(struct sslCheckOptions *options, int sslVersion)
 {
 	// Variables...
 	int returnCode = true;
+	const SSL_METHOD *sslMethod = sslVersionMethod(sslVersion);
 	struct sslCipher *sslCipherPointer;
+	struct sslCipher *entries;
+	struct sslCipher **last;
+	const SSL_CIPHER *cipher;
+	int count = 0;
 	int tempInt;
 	int loop;
 	STACK_OF(SSL_CIPHER) *cipherList;
+	SSL_CTX *ctx;
 	SSL *ssl = NULL;
 
 	// Setup Context Object...
-	options->ctx = SSL_CTX_new(sslMethod);
-	if (options->ctx != NULL)
+	ctx = SSL_CTX_new(sslMethod);
+	if (ctx != NULL)
 	{
-		SSL_CTX_set_cipher_list(options->ctx, "ALL:COMPLEMENTOFALL");
+		SSL_CTX_set_cipher_list(ctx, "ALL:COMPLEMENTOFALL");
+#ifdef TLS1_3_VERSION
+		if (sslVersion == tls_v1_3)
+			SSL_CTX_set_ciphersuites(ctx, tls13_suites);
+#endif
 
 		// Create new SSL object
-		ssl = SSL_new(options->ctx);
+		ssl = SSL_new(ctx);
 		if (ssl != NULL)
 		{
 			// Get List of Ciphers
 			cipherList = SSL_get_ciphers(ssl);
 	
-			// Create Cipher Struct Entries...
-			for (loop = 0; loop < sk_SSL_CIPHER_num(cipherList); loop++)
+			// Create Cipher Struct Entries, in one block...
+			entries = calloc(sk_SSL_CIPHER_num(cipherList) + 1, sizeof(struct sslCipher));
+			if (entries == NULL)
+				returnCode = false;
+			for (loop = 0; (entries != NULL) && (loop < sk_SSL_CIPHER_num(cipherList)); loop++)
 			{
-				// Create Structure...
-				if (options->ciphers == 0)
-				{
-					options->ciphers = malloc(sizeof(struct sslCipher));
-					sslCipherPointer = options->ciphers;
-				}
-				else
-				{
-					sslCipherPointer = options->ciphers;
-					while (sslCipherPointer->next != 0)
-						sslCipherPointer = sslCipherPointer->next;
-					sslCipherPointer->next = malloc(sizeof(struct sslCipher));
-					sslCipherPointer = sslCipherPointer->next;
-				}
-	
-				// Init
-				memset(sslCipherPointer, 0, sizeof(struct sslCipher));
-	
+				// TLS 1.3 suites are listed with every method, they go with tls_v1_3 only
+				cipher = sk_SSL_CIPHER_value(cipherList, loop);
+#ifdef TLS1_3_VERSION
+				if ((strcmp(SSL_CIPHER_get_version(cipher), "TLSv1.3") == 0) != (sslVersion == tls_v1_3))
+					continue;
+#endif
+				sslCipherPointer = entries + count;
+				if (count > 0)
+					entries[count - 1].next = sslCipherPointer;
+				count++;
+
 				// Add cipher information...
 				sslCipherPointer->sslMethod = sslMethod;
-				sslCipherPointer->name = SSL_CIPHER_get_name(sk_SSL_CIPHER_value(cipherList, loop));
-				sslCipherPointer->version = SSL_CIPHER_get_version(sk_SSL_CIPHER_value(cipherList, loop));
-				SSL_CIPHER_description(sk_SSL_CIPHER_value(cipherList, loop), sslCipherPointer->description, sizeof(sslCipherPointer->description) - 1);
-				sslCipherPointer->bits = SSL_CIPHER_get_bits(sk_SSL_CIPHER_value(cipherList, loop), &tempInt);
+				sslCipherPointer->sslVersion = sslVersion;
+				sslCipherPointer->name = SSL_CIPHER_get_name(cipher);
+				sslCipherPointer->id = SSL_CIPHER_get_id(cipher);
+				sslCipherPointer->version = SSL_CIPHER_get_version(cipher);
+				sslCipherPointer->bits = SSL_CIPHER_get_bits(cipher, &tempInt);
+			}
+
+			// Link them to the end of the catalog...
+			if ((entries != NULL) && (count > 0))
+			{
+				for (last = &cipherCatalog; *last != 0; last = &(*last)->next)
+					;
+				__atomic_store_n(last, entries, __ATOMIC_RELEASE);
 			}
+			else
+				free(entries);
 	
 			// Free SSL object
 			SSL_free(ssl);
@@ -216,24 +695,55 @@ int populateCipherList(struct sslCheckOptions *options, const SSL_METHOD *sslMet
 		else
 		{
 			returnCode = false;
-			printf("%sERROR: Could not create SSL object.%s\n", COL_RED, RESET);
+			scanError(options, "ERROR: Could not create SSL object.");
 		}
 
 		// Free CTX Object
-		SSL_CTX_free(options->ctx);
+		SSL_CTX_free(ctx);
 	}
 
 	// Error Creating Context Object
 	else
 	{
 		returnCode = false;
-		printf("%sERROR: Could not create CTX object.%s\n", COL_RED, RESET);
+		scanError(options, "ERROR: Could not create CTX object.");
 	}
 
 	return returnCode;
 }
 
 
+// Add the ciphers of the requested protocols not yet in the catalog...
+int populateCiphers(struct sslCheckOptions *options)
+{
+	// Variables...
+	int missing;
+	int status = true;
+
+	while (__sync_lock_test_and_set(&catalogLock, 1) != 0)
+		sched_yield();
+	missing = options->sslVersion & ~catalogVersions;
+
+#ifndef DISABLE_SSLv2
+	if ((missing & ssl_v2) && (populateCipherList(options, ssl_v2) == false)) status = false;
+#endif
+#ifndef OPENSSL_NO_SSL3_METHOD
+	if ((missing & ssl_v3) && (populateCipherList(options, ssl_v3) == false)) status = false;
+#endif
+	if ((missing & tls_v1) && (populateCipherList(options, tls_v1) == false)) status = false;
+	if ((missing & tls_v1_1) && (populateCipherList(options, tls_v1_1) == false)) status = false;
+	if ((missing & tls_v1_2) && (populateCipherList(options, tls_v1_2) == false)) status = false;
+#ifdef TLS1_3_VERSION
+	if ((missing & tls_v1_3) && (populateCipherList(options, tls_v1_3) == false)) status = false;
+#endif
+	if (status == true)
+		catalogVersions |= options->sslVersion;
+	__sync_lock_release(&catalogLock);
+
+	return status;
+}
+
+
 // File Exists
 int fileExists(char *fileName)
 {
@@ -266,242 +776,831 @@ void readLine(FILE *input, char *lineFromFile, int maxSize)
 }
 
 
-// Create a TCP socket
-int tcpConnect(struct sslCheckOptions *options)
+// Free the cipher classes of the policy...
+void freePolicy(struct sslCheckOptions *options)
 {
 	// Variables...
-	int socketDescriptor;
-	char buffer[BUFFERSIZE];
-	struct sockaddr_in localAddress;
-	int status;
+	struct policyClass *policyClass;
 
-	// Create Socket
-	socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
-	if(socketDescriptor < 0)
+	while (options->policy != 0)
 	{
-		printf("%s    ERROR: Could not open a socket.%s\n", COL_RED, RESET);
-		return 0;
+		policyClass = options->policy->next;
+		free(options->policy);
+		options->policy = policyClass;
 	}
+}
 
-	// Configure Local Port
-	localAddress.sin_family = AF_INET;
-	localAddress.sin_addr.s_addr = htonl(INADDR_ANY);
-	localAddress.sin_port = htons(0);
-	status = bind(socketDescriptor, (struct sockaddr *) &localAddress, sizeof(localAddress));
-	if(status < 0)
-	{
-		printf("%s    ERROR: Could not bind to port.%s\n", COL_RED, RESET);
-		return 0;
-	}
 
-	// Connect
-	status = connect(socketDescriptor, (struct sockaddr *) &options->serverAddress, sizeof(options->serverAddress));
-	if(status < 0)
-	{
-		printf("%s    ERROR: Could not open a connection to host %s on port %d.%s\n", COL_RED, options->host, options->port, RESET);
-		return 0;
-	}
-	// If SMTP STARTTLS is required...
-	if (options->esmtps == true)
-	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "220", 3) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an SMTP service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "EHLO titania.co.uk\r\n", 20, 0);
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "250", 3) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The SMTP service on %s port %d did not respond with status 250 to our HELO.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "STARTTLS\r\n", 10, 0);
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "220", 3) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The SMTP service on %s port %d did not appear to support STARTTLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-	}
-	// IF FTPS we go for ftp over ssl
-	else if (options->ftps == true)
-	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "220", 3) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an FTP service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "AUTH TLS\r\n", 20, 0); // We want to start TLS...
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "234", 3) != 0) // ...and expect 234 to start with the negotiation
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The FTP service on %s port %d did not respond with status 234 to our AUTH TLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-	}
-	// IF POP3S STLS
-	else if (options->pop3s == true)
-	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "+OK", 3) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an POP3 service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "STLS\r\n", 20, 0); // We want to start TLS...
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "+OK", 3) != 0) // ...and expect +OK to start with the negotiation
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The POP3 service on %s port %d did not respond with status +OK to our STLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-	}
-	// IF IMAPS SARTTLS
-	else if (options->imaps == true)
+// Load a cipher class policy file...
+//   One class per line, "<name> <OpenSSL cipher string> [protocol]", where
+//   the protocol is one of ssl2, ssl3, tls1, tls1_1 or tls1_2 (default is
+//   whatever the server negotiates). Empty lines and # comments are skipped.
+int loadPolicy(struct sslCheckOptions *options, const char *fileName)
+{
+	// Variables...
+	FILE *policyFile;
+	char line[1024];
+	char protocol[16];
+	struct policyClass policyClass;
+	struct policyClass **last;
+	int lineNumber = 0;
+	int fields;
+
+	freePolicy(options);
+	policyFile = fopen(fileName, "r");
+	if (policyFile == NULL)
 	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "* OK", 4) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an IMAP service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "AA STARTTLS\r\n", 20, 0); // We want to start TLS...
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "AA", 2) != 0) // ...and expect our AA token to start with the negotiation
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The IMAP service on %s port %d did not respond with our token to our SARTTLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
+		scanError(options, "ERROR: Could not open the policy file %s.", fileName);
+		return false;
 	}
-	// IF FTPS we go for ftp over ssl
-	else if (options->ftps == true)
+
+	last = &options->policy;
+	while (fgets(line, sizeof(line), policyFile) != NULL)
 	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "220", 3) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an FTP service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "AUTH TLS\r\n", 20, 0); // We want to start TLS...
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "234", 3) != 0) // ...and expect 234 to start with the negotiation
+		lineNumber++;
+		if (strchr(line, '#') != NULL)
+			*strchr(line, '#') = 0;
+		memset(&policyClass, 0, sizeof(policyClass));
+		fields = sscanf(line, "%63s %511s %15s", policyClass.name, policyClass.ciphers, protocol);
+		if (fields <= 0)
+			continue;
+
+		// Protocol of the class...
+		if (fields == 3)
 		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The FTP service on %s port %d did not respond with status 234 to our AUTH TLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
+#ifndef DISABLE_SSLv2
+			if (strcmp(protocol, "ssl2") == 0)
+				policyClass.sslVersion = ssl_v2;
+#endif
+			if (strcmp(protocol, "ssl3") == 0)
+				policyClass.sslVersion = ssl_v3;
+			else if (strcmp(protocol, "tls1") == 0)
+				policyClass.sslVersion = tls_v1;
+			else if (strcmp(protocol, "tls1_1") == 0)
+				policyClass.sslVersion = tls_v1_1;
+			else if (strcmp(protocol, "tls1_2") == 0)
+				policyClass.sslVersion = tls_v1_2;
 		}
-	}
-	// IF POP3S STLS
-	else if (options->pop3s == true)
-	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		printf("%s",buffer);
-		if (strncmp(buffer, "+OK", 3) != 0)
+		if ((fields == 1) || ((fields == 3) && (policyClass.sslVersion == ssl_none)))
 		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an POP3 service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
+			scanError(options, "ERROR: Invalid class on line %d of the policy file %s.", lineNumber, fileName);
+			fclose(policyFile);
+			freePolicy(options);
+			return false;
 		}
-		send(socketDescriptor, "STLS\r\n", 20, 0); // We want to start TLS...
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "+OK", 3) != 0) // ...and expect +OK to start with the negotiation
+
+		*last = malloc(sizeof(struct policyClass));
+		if (*last == NULL)
 		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The POP3 service on %s port %d did not respond with status +OK to our STLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
+			fclose(policyFile);
+			freePolicy(options);
+			return false;
 		}
+		memcpy(*last, &policyClass, sizeof(struct policyClass));
+		last = &(*last)->next;
 	}
-	// IF IMAPS SARTTLS
-	else if (options->imaps == true)
+	fclose(policyFile);
+
+	if (options->policy == 0)
 	{
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "* OK", 4) != 0)
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The host %s on port %d did not appear to be an IMAP service.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
-		send(socketDescriptor, "AA STARTTLS\r\n", 20, 0); // We want to start TLS...
-		memset(buffer, 0, BUFFERSIZE);
-		recv(socketDescriptor, buffer, BUFFERSIZE - 1, 0);
-		if (strncmp(buffer, "AA", 2) != 0) // ...and expect our AA token to start with the negotiation
-		{
-			close(socketDescriptor);
-			printf("%s    ERROR: The IMAP service on %s port %d did not respond with our token to our SARTTLS.%s\n", COL_RED, options->host, options->port, RESET);
-			return 0;
-		}
+		scanError(options, "ERROR: The policy file %s has no cipher classes.", fileName);
+		return false;
 	}
+	return true;
+}
 
-	// Return
-	return socketDescriptor;
+
+// Get the current time in microseconds...
+long long timeMicroseconds()
+{
+	// Variables...
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return ((long long)now.tv_sec * 1000000) + now.tv_usec;
 }
 
 
-// Private Key Password Callback...
-static int password_callback(char *buf, int size, int rwflag, void *userdata)
+// Get the name of a SSL/TLS protocol method...
+const char *sslMethodName(const SSL_METHOD *sslMethod)
 {
-	strncpy(buf, (char *)userdata, size);
-	buf[strlen(userdata)] = 0;
-	return strlen(userdata);
+#ifndef DISABLE_SSLv2
+	if (sslMethod == SSLv2_client_method())
+		return "SSLv2";
+#endif
+#ifndef OPENSSL_NO_SSL3_METHOD
+	if (sslMethod == SSLv3_client_method())
+		return "SSLv3";
+#endif
+	if (sslMethod == TLSv1_client_method())
+		return "TLSv1";
+	else if (sslMethod == TLSv1_1_client_method())
+		return "TLSv1.1";
+	else if (sslMethod == TLSv1_2_client_method())
+		return "TLSv1.2";
+	return "";
 }
 
 
-// Load client certificates/private keys...
-int loadCerts(struct sslCheckOptions *options)
+// Get the name of a protocol version bitmask...
+const char *sslVersionName(int sslVersion)
 {
-	// Variables...
-	int status = 1;
-	PKCS12 *pk12 = NULL;
-	FILE *pk12File = NULL;
-	X509 *cert = NULL;
-	EVP_PKEY *pkey = NULL;
-	STACK_OF(X509) *ca = NULL;
+	if (sslVersion == ssl_v2)
+		return "SSLv2";
+	else if (sslVersion == ssl_v3)
+		return "SSLv3";
+	else if (sslVersion == tls_v1_3)
+		return "TLSv1.3";
+	return sslMethodName(sslVersionMethod(sslVersion));
+}
 
-	// Configure PKey password...
-	if (options->privateKeyPassword != 0)
-	{
-		SSL_CTX_set_default_passwd_cb_userdata(options->ctx, (void *)options->privateKeyPassword);
-		SSL_CTX_set_default_passwd_cb(options->ctx, password_callback);
-	}
+
+// Trace span (Chrome trace-event format), also timed for the metrics...
+struct traceSpan
+{
+	int phase;
+	long long start;
+};
+
+
+// Write a JSON string...
+void jsonString(FILE *output, const char *string)
+{
+	fputc('"', output);
+	for (; *string != 0; string++)
+	{
+		if ((*string == '"') || (*string == '\\'))
+			fprintf(output, "\\%c", *string);
+		else if ((unsigned char)*string < 0x20)
+			fprintf(output, "\\u%04x", *string);
+		else
+			fputc(*string, output);
+	}
+	fputc('"', output);
+}
+
+
+// Start a trace span...
+void traceBegin(struct sslCheckOptions *options, struct traceSpan *span, int phase)
+{
+	span->phase = phase;
+	if ((options->traceOutput != 0) || (options->metrics != 0))
+		span->start = timeMicroseconds();
+}
+
+
+// Finish a trace span and write it as a complete event...
+//   Every event is written out on its own, so that the events of
+//   processes sharing the file (--parallel) do not interleave.
+void traceEnd(struct sslCheckOptions *options, struct traceSpan *span, const char *cipher, const char *version, const char *result)
+{
+	// Variables...
+	long long end;
+	int bucket;
+
+	if ((options->traceOutput == 0) && (options->metrics == 0))
+		return;
+	end = timeMicroseconds();
+
+	// Latency histogram...
+	if (options->metrics != 0)
+	{
+		metricsAdd(options, phaseCount[span->phase], 1);
+		metricsAdd(options, phaseSum[span->phase], (long)(end - span->start));
+		for (bucket = 0; (bucket < metrics_buckets) && (end - span->start > metricsBuckets[bucket]); bucket++)
+			;
+		if (bucket < metrics_buckets)
+			metricsAdd(options, phaseBuckets[span->phase][bucket], 1);
+	}
+	if (options->traceOutput == 0)
+		return;
+
+	// One event at a time, handles may share the trace file...
+	flockfile(options->traceOutput);
+	fprintf(options->traceOutput, ",\n{\"name\":\"%s\",\"cat\":\"sslscan\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"host\":", phaseNames[span->phase], span->start, end - span->start, (int)getpid(), options->traceThread);
+	jsonString(options->traceOutput, options->host);
+	fprintf(options->traceOutput, ",\"port\":%d", options->port);
+	if ((cipher != 0) && (cipher[0] != 0))
+	{
+		fprintf(options->traceOutput, ",\"cipher\":");
+		jsonString(options->traceOutput, cipher);
+	}
+	if ((version != 0) && (version[0] != 0))
+		fprintf(options->traceOutput, ",\"version\":\"%s\"", version);
+	if (result != 0)
+		fprintf(options->traceOutput, ",\"result\":\"%s\"", result);
+	fprintf(options->traceOutput, "}}");
+	fflush(options->traceOutput);
+	funlockfile(options->traceOutput);
+}
+
+
+// Count the outcome of a probe handshake...
+void metricsProbe(struct sslCheckOptions *options, int cipherStatus)
+{
+	if (options->metrics == 0)
+		return;
+
+	metricsAdd(options, handshakes, 1);
+	if (cipherStatus == 1)
+		metricsAdd(options, probesAccepted, 1);
+	else if (cipherStatus == 0)
+		metricsAdd(options, probesRejected, 1);
+	else
+	{
+		metricsAdd(options, probesFailed, 1);
+		if ((errno == ETIMEDOUT) || (errno == EAGAIN))
+			metricsAdd(options, probesTimedOut, 1);
+	}
+}
+
+
+// Add a connect time to the round trip estimate of the host (RFC 6298)...
+void rttSample(struct sslCheckOptions *options, long long rtt)
+{
+	if (options->smoothedRtt == 0)
+	{
+		options->smoothedRtt = rtt;
+		options->rttVariance = rtt / 2;
+	}
+	else
+	{
+		options->rttVariance = (3 * options->rttVariance + llabs(options->smoothedRtt - rtt)) / 4;
+		options->smoothedRtt = (7 * options->smoothedRtt + rtt) / 8;
+	}
+}
+
+
+// Timeout for connecting to the host (microseconds)...
+long long connectTimeout(struct sslCheckOptions *options)
+{
+	// Variables...
+	long long timeout;
+
+	if (options->smoothedRtt == 0)
+		return timeout_initial;
+	timeout = options->smoothedRtt + 4 * options->rttVariance;
+	if (timeout < timeout_rto_min)
+		return timeout_rto_min;
+	if (timeout > timeout_rto_max)
+		return timeout_rto_max;
+	return timeout;
+}
+
+
+// Timeout for a handshake or read on a connection to the host (microseconds)...
+long long readTimeout(struct sslCheckOptions *options)
+{
+	// Variables...
+	long long timeout = timeout_read_rtos * connectTimeout(options);
+
+	if (timeout < timeout_read_min)
+		return timeout_read_min;
+	return timeout;
+}
+
+
+// Name the timeline row used for the current host...
+void traceHost(struct sslCheckOptions *options)
+{
+	if (options->traceOutput == 0)
+		return;
+
+	options->traceThread = __sync_add_and_fetch(&traceThreads, 1);
+	flockfile(options->traceOutput);
+	fprintf(options->traceOutput, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", (int)getpid(), options->traceThread);
+	jsonString(options->traceOutput, options->host);
+	fprintf(options->traceOutput, "}}");
+	fflush(options->traceOutput);
+	funlockfile(options->traceOutput);
+}
+
+
+// STARTTLS dialogue step, the command sent and the reply expected...
+struct starttlsCommand
+{
+	const char *command;
+	const char *expect;
+	const char *error;
+};
+
+// SMTP STARTTLS
+const struct starttlsCommand starttlsSmtp[] = {
+	{ 0, "220", "    ERROR: The host %s on port %d did not appear to be an SMTP service." },
+	{ "EHLO titania.co.uk\r\n", "250", "    ERROR: The SMTP service on %s port %d did not respond with status 250 to our HELO." },
+	{ "STARTTLS\r\n", "220", "    ERROR: The SMTP service on %s port %d did not appear to support STARTTLS." },
+	{ 0, 0, 0 } };
+
+// FTP AUTH TLS
+const struct starttlsCommand starttlsFtp[] = {
+	{ 0, "220", "    ERROR: The host %s on port %d did not appear to be an FTP service." },
+	{ "AUTH TLS\r\n", "234", "    ERROR: The FTP service on %s port %d did not respond with status 234 to our AUTH TLS." },
+	{ 0, 0, 0 } };
+
+// POP3 STLS
+const struct starttlsCommand starttlsPop3[] = {
+	{ 0, "+OK", "    ERROR: The host %s on port %d did not appear to be an POP3 service." },
+	{ "STLS\r\n", "+OK", "    ERROR: The POP3 service on %s port %d did not respond with status +OK to our STLS." },
+	{ 0, 0, 0 } };
+
+// IMAP STARTTLS (tagged AA)
+const struct starttlsCommand starttlsImap[] = {
+	{ 0, "* OK", "    ERROR: The host %s on port %d did not appear to be an IMAP service." },
+	{ "AA STARTTLS\r\n", "AA OK", "    ERROR: The IMAP service on %s port %d did not respond with our token to our SARTTLS." },
+	{ 0, 0, 0 } };
+
+// STARTTLS dialogue state (buffered, line oriented, non-blocking)...
+//   An event loop waits for state->events on state->socketDescriptor
+//   and calls starttlsStep() whenever the socket is ready.
+struct starttlsState
+{
+	const struct starttlsCommand *commands;
+	int protocol;
+	int step;
+	int queued;
+	int pipelining;
+	int capabilities;
+	int socketDescriptor;
+	int events;
+	char input[BUFFERSIZE];
+	int inputUsed;
+	char output[BUFFERSIZE];
+	int outputUsed;
+};
+
+
+// Start a STARTTLS dialogue on a connected socket...
+int starttlsInit(struct sslCheckOptions *options, struct starttlsState *state, int socketDescriptor)
+{
+	memset(state, 0, sizeof(struct starttlsState));
+	state->socketDescriptor = socketDescriptor;
+	state->events = POLLIN;
+	if (options->esmtps == true)
+	{
+		state->protocol = starttls_smtp;
+		state->commands = starttlsSmtp;
+
+		// The host advertised PIPELINING on an earlier probe, send EHLO and STARTTLS at once
+		if ((options->smtpPipelining == true) && (options->smtpCapabilities & smtp_pipelining))
+			state->pipelining = true;
+	}
+	else if (options->ftps == true)
+	{
+		state->protocol = starttls_ftp;
+		state->commands = starttlsFtp;
+	}
+	else if (options->pop3s == true)
+	{
+		state->protocol = starttls_pop3;
+		state->commands = starttlsPop3;
+	}
+	else if (options->imaps == true)
+	{
+		state->protocol = starttls_imap;
+		state->commands = starttlsImap;
+	}
+	else
+		return false;
+	return true;
+}
+
+
+// Is this the last line of a reply?
+int starttlsReplyEnd(struct starttlsState *state, const char *line)
+{
+	switch (state->protocol)
+	{
+		// "250-..." lines continue the reply, "250 ..." ends it
+		case starttls_smtp:
+		case starttls_ftp:
+			return (isdigit((unsigned char)line[0]) && isdigit((unsigned char)line[1]) && isdigit((unsigned char)line[2]) && (line[3] != '-'));
+
+		// Untagged "* ..." lines come before the tagged reply
+		case starttls_imap:
+			return ((state->step == 0) || (strncmp(line, "AA ", 3) == 0));
+
+		default:
+			return true;
+	}
+}
+
+
+// Handle a received line, queue the next command once a reply is complete...
+int starttlsLine(struct sslCheckOptions *options, struct starttlsState *state, char *line)
+{
+	// Variables...
+	const struct starttlsCommand *command = state->commands + state->step;
+	int length = strlen(line);
+
+	if ((length > 0) && (line[length - 1] == '\r'))
+		line[length - 1] = 0;
+
+	// SMTP EHLO reply, one keyword per line...
+	if ((state->protocol == starttls_smtp) && (state->step == 1) && (strlen(line) >= 14) && (strncmp(line, "250", 3) == 0) && (strncasecmp(line + 4, "PIPELINING", 10) == 0) && ((line[14] == 0) || (line[14] == ' ')))
+		state->capabilities |= smtp_pipelining;
+
+	if (starttlsReplyEnd(state, line) == false)
+		return starttls_wait;
+
+	if (strncmp(line, command->expect, strlen(command->expect)) != 0)
+	{
+		scanError(options, command->error, options->host, options->port);
+		return starttls_failed;
+	}
+	if ((state->protocol == starttls_smtp) && (state->step == 1))
+		options->smtpCapabilities = state->capabilities;
+
+	// Next step...
+	state->step++;
+	if (state->commands[state->step].expect == 0)
+		return starttls_done;
+
+	// Queue its command (pipelined: all remaining commands)...
+	while ((state->queued < state->step) || ((state->pipelining == true) && (state->commands[state->queued + 1].expect != 0)))
+	{
+		state->queued++;
+		command = state->commands + state->queued;
+		length = strlen(command->command);
+		memcpy(state->output + state->outputUsed, command->command, length);
+		state->outputUsed += length;
+	}
+	return starttls_wait;
+}
+
+
+// Advance a STARTTLS dialogue as far as the socket allows...
+//   Never blocks. Returns starttls_wait when the socket has to become
+//   ready for state->events first, else starttls_done or starttls_failed.
+int starttlsStep(struct sslCheckOptions *options, struct starttlsState *state)
+{
+	// Variables...
+	char *newLine;
+	int start;
+	int size;
+	int status;
+
+	while (true)
+	{
+		// Send the queued command...
+		if (state->outputUsed > 0)
+		{
+			size = send(state->socketDescriptor, state->output, state->outputUsed, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if ((size < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+			{
+				state->events = POLLOUT;
+				return starttls_wait;
+			}
+			if (size < 0)
+				break;
+			state->outputUsed -= size;
+			memmove(state->output, state->output + size, state->outputUsed);
+			continue;
+		}
+
+		// Receive what is there...
+		size = recv(state->socketDescriptor, state->input + state->inputUsed, sizeof(state->input) - 1 - state->inputUsed, MSG_DONTWAIT);
+		if ((size < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+		{
+			state->events = POLLIN;
+			return starttls_wait;
+		}
+		if (size <= 0)
+			break;
+		state->inputUsed += size;
+
+		// Complete lines...
+		start = 0;
+		while ((newLine = memchr(state->input + start, '\n', state->inputUsed - start)) != NULL)
+		{
+			*newLine = 0;
+			status = starttlsLine(options, state, state->input + start);
+			start = newLine + 1 - state->input;
+			if (status != starttls_wait)
+				return status;
+		}
+		state->inputUsed -= start;
+		memmove(state->input, state->input + start, state->inputUsed);
+
+		// Overlong line, only its start matters...
+		if (state->inputUsed == sizeof(state->input) - 1)
+			state->inputUsed = 8;
+		state->input[state->inputUsed] = 0;
+	}
+
+	// Connection closed or broken...
+	scanError(options, state->commands[state->step].error, options->host, options->port);
+	return starttls_failed;
+}
+
+
+// Run the application layer STARTTLS dialogue...
+int starttlsDialogue(struct sslCheckOptions *options, int socketDescriptor)
+{
+	// Variables...
+	struct starttlsState state;
+	struct pollfd pollDescriptor;
+	int status = starttls_failed;
+	int ready;
+
+	if (starttlsInit(options, &state, socketDescriptor) == true)
+	{
+		status = starttlsStep(options, &state);
+		while (status == starttls_wait)
+		{
+			pollDescriptor.fd = socketDescriptor;
+			pollDescriptor.events = state.events;
+			pollDescriptor.revents = 0;
+			ready = poll(&pollDescriptor, 1, readTimeout(options) / 1000);
+			if ((ready == 0) || ((ready < 0) && (errno != EINTR)))
+			{
+				if (ready == 0)
+				{
+					metricsAdd(options, probesTimedOut, 1);
+					options->failure = failure_timeout;
+				}
+				scanError(options, state.commands[state.step].error, options->host, options->port);
+				status = starttls_failed;
+				break;
+			}
+			status = starttlsStep(options, &state);
+		}
+	}
+
+	return (status == starttls_done);
+}
+
+
+// Wait for a non-blocking connect, at most the connect timeout of the host...
+int connectWait(struct sslCheckOptions *options, int socketDescriptor)
+{
+	// Variables...
+	struct pollfd pollDescriptor;
+	long long deadline = timeMicroseconds() + connectTimeout(options);
+	long long remaining;
+	int socketError = 0;
+	socklen_t length = sizeof(socketError);
+	int ready;
+
+	pollDescriptor.fd = socketDescriptor;
+	pollDescriptor.events = POLLOUT;
+	do
+	{
+		remaining = deadline - timeMicroseconds();
+		pollDescriptor.revents = 0;
+		ready = (remaining > 0) ? poll(&pollDescriptor, 1, (remaining + 999) / 1000) : 0;
+	}
+	while ((ready < 0) && (errno == EINTR));
+
+	if (ready == 0)
+		errno = ETIMEDOUT;
+	if (ready <= 0)
+		return -1;
+	if (getsockopt(socketDescriptor, SOL_SOCKET, SO_ERROR, &socketError, &length) < 0)
+		return -1;
+	if (socketError != 0)
+	{
+		errno = socketError;
+		return -1;
+	}
+	return 0;
+}
+
+
+// Classify a failed socket call from its errno...
+int socketFailure(int error)
+{
+	switch (error)
+	{
+		case 0:
+			return failure_closed;
+		case ETIMEDOUT:
+		case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+		case EWOULDBLOCK:
+#endif
+			return failure_timeout;
+		case ECONNRESET:
+		case EPIPE:
+			return failure_reset;
+		case EMFILE:
+		case ENFILE:
+		case ENOBUFS:
+		case ENOMEM:
+		case EADDRINUSE:
+		case EADDRNOTAVAIL:
+			return failure_local;
+		default:
+			return failure_network;
+	}
+}
+
+
+// Back off before retrying a transient failure (false if it is not retried)...
+//   Exponential backoff with jitter, at most retry_attempts per probe and
+//   retry_budget for all probes of a host.
+int retryProbe(struct sslCheckOptions *options, int failure, int attempt)
+{
+	// Variables...
+	struct timespec delay;
+	long long backoff;
+
+	if ((failure == failure_none) || (failure > failure_transient) || (attempt >= retry_attempts) || (options->retryBudget <= 0))
+		return false;
+	options->retryBudget--;
+	metricsAdd(options, probesRetried, 1);
+
+	backoff = (long long)retry_backoff << attempt;
+	if (backoff > retry_backoff_max)
+		backoff = retry_backoff_max;
+	backoff = backoff / 2 + rand_r(&options->retrySeed) % (backoff / 2 + 1);
+	delay.tv_sec = backoff / 1000000;
+	delay.tv_nsec = (backoff % 1000000) * 1000;
+	while ((nanosleep(&delay, &delay) < 0) && (errno == EINTR))
+	{ }
+	return true;
+}
+
+
+// Close a socket that never carried a probe...
+void socketClose(struct sslCheckOptions *options, int socketDescriptor)
+{
+	close(socketDescriptor);
+	options->openSockets--;
+}
+
+
+// Close the connection of a probe...
+//   An abortive close resets the connection instead of leaving it in
+//   TIME_WAIT, so that high probe rates do not run out of ports.
+void tcpClose(struct sslCheckOptions *options, int socketDescriptor)
+{
+	// Variables...
+	struct linger linger;
+
+	if (options->abortiveClose == true)
+	{
+		linger.l_onoff = 1;
+		linger.l_linger = 0;
+		setsockopt(socketDescriptor, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+	}
+	socketClose(options, socketDescriptor);
+	metricsAdd(options, connectionsInFlight, -1);
+}
+
+
+// Create a TCP socket (one attempt)...
+//   Returns -1 if the connect failed (not yet reported), 0 for any other
+//   failure, options->failure tells which.
+int tcpOpen(struct sslCheckOptions *options)
+{
+	// Variables...
+	int socketDescriptor;
+	struct sockaddr_in localAddress;
+	struct traceSpan span;
+	struct timeval timeout;
+	long long connectStart;
+	int flags;
+	int status;
+
+	// Create Socket
+	options->failure = failure_local;
+	socketDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+	if(socketDescriptor < 0)
+	{
+		scanError(options, "    ERROR: Could not open a socket.");
+		return 0;
+	}
+	options->openSockets++;
+
+	// Source address of the pool, in turn (the port is left to connect(),
+	// which can reuse it towards other destinations)...
+	if (options->sourceCount > 0)
+	{
+		memset(&localAddress, 0, sizeof(localAddress));
+		localAddress.sin_family = AF_INET;
+		localAddress.sin_addr = options->sourceAddresses[options->sourceNext];
+		localAddress.sin_port = htons(0);
+		options->sourceNext = (options->sourceNext + 1) % options->sourceCount;
+#ifdef IP_BIND_ADDRESS_NO_PORT
+		flags = 1;
+		setsockopt(socketDescriptor, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &flags, sizeof(flags));
+#endif
+		status = bind(socketDescriptor, (struct sockaddr *) &localAddress, sizeof(localAddress));
+		if(status < 0)
+		{
+			if (errno == EADDRNOTAVAIL)
+				options->failure = failure_network;
+			scanError(options, "    ERROR: Could not bind to %s.", inet_ntoa(localAddress.sin_addr));
+			socketClose(options, socketDescriptor);
+			return 0;
+		}
+	}
+
+	// Connect (non-blocking, to give up after the connect timeout)
+	traceBegin(options, &span, phase_connect);
+	connectStart = timeMicroseconds();
+	flags = fcntl(socketDescriptor, F_GETFL);
+	fcntl(socketDescriptor, F_SETFL, flags | O_NONBLOCK);
+	status = connect(socketDescriptor, (struct sockaddr *) &options->serverAddress, sizeof(options->serverAddress));
+	if ((status < 0) && (errno == EINPROGRESS))
+		status = connectWait(options, socketDescriptor);
+	fcntl(socketDescriptor, F_SETFL, flags);
+	traceEnd(options, &span, 0, 0, (status < 0) ? "failed" : "connected");
+	if(status < 0)
+	{
+		options->failure = socketFailure(errno);
+		if (errno == ETIMEDOUT)
+			metricsAdd(options, probesTimedOut, 1);
+		socketClose(options, socketDescriptor);
+		return -1;
+	}
+
+	// Handshakes and reads time out after a few round trips...
+	rttSample(options, timeMicroseconds() - connectStart);
+	timeout.tv_sec = readTimeout(options) / 1000000;
+	timeout.tv_usec = readTimeout(options) % 1000000;
+	setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(socketDescriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	// Application layer STARTTLS...
+	if ((options->esmtps == true) || (options->ftps == true) || (options->pop3s == true) || (options->imaps == true))
+	{
+		options->failure = failure_protocol;
+		traceBegin(options, &span, phase_starttls);
+		status = starttlsDialogue(options, socketDescriptor);
+		traceEnd(options, &span, 0, 0, (status == true) ? "ok" : "failed");
+		if (status == false)
+		{
+			socketClose(options, socketDescriptor);
+			return 0;
+		}
+	}
+
+	// Return
+	options->failure = failure_none;
+	metricsAdd(options, connectionsInFlight, 1);
+	return socketDescriptor;
+}
+
+
+// Create a TCP socket, retrying transient failures...
+int tcpConnect(struct sslCheckOptions *options)
+{
+	// Variables...
+	int socketDescriptor;
+	int attempt = 0;
+
+	do
+		socketDescriptor = tcpOpen(options);
+	while ((socketDescriptor <= 0) && (retryProbe(options, options->failure, attempt++) == true));
+
+	if (socketDescriptor < 0)
+	{
+		scanError(options, "    ERROR: Could not open a connection to host %s on port %d.", options->host, options->port);
+		return 0;
+	}
+	return socketDescriptor;
+}
+
+
+// Private Key Password Callback...
+static int password_callback(char *buf, int size, int rwflag, void *userdata)
+{
+	strncpy(buf, (char *)userdata, size);
+	buf[strlen(userdata)] = 0;
+	return strlen(userdata);
+}
+
+
+// Load client certificates/private keys...
+int loadCerts(struct sslCheckOptions *options, SSL_CTX *ctx)
+{
+	// Variables...
+	int status = 1;
+	PKCS12 *pk12 = NULL;
+	FILE *pk12File = NULL;
+	X509 *cert = NULL;
+	EVP_PKEY *pkey = NULL;
+	STACK_OF(X509) *ca = NULL;
+
+	// Configure PKey password...
+	if (options->privateKeyPassword != 0)
+	{
+		SSL_CTX_set_default_passwd_cb_userdata(ctx, (void *)options->privateKeyPassword);
+		SSL_CTX_set_default_passwd_cb(ctx, password_callback);
+	}
 
 	// Seperate Certs and PKey Files...
 	if ((options->clientCertsFile != 0) && (options->privateKeyFile != 0))
 	{
 		// Load Cert...
-		if (!SSL_CTX_use_certificate_file(options->ctx, options->clientCertsFile, SSL_FILETYPE_PEM))
+		if (!SSL_CTX_use_certificate_file(ctx, options->clientCertsFile, SSL_FILETYPE_PEM))
 		{
-			if (!SSL_CTX_use_certificate_file(options->ctx, options->clientCertsFile, SSL_FILETYPE_ASN1))
+			if (!SSL_CTX_use_certificate_file(ctx, options->clientCertsFile, SSL_FILETYPE_ASN1))
 			{
-				if (!SSL_CTX_use_certificate_chain_file(options->ctx, options->clientCertsFile))
+				if (!SSL_CTX_use_certificate_chain_file(ctx, options->clientCertsFile))
 				{
-					printf("%s    Could not configure certificate(s).%s\n", COL_RED, RESET);
+					scanError(options, "    Could not configure certificate(s).");
 					status = 0;
 				}
 			}
@@ -510,15 +1609,15 @@ int loadCerts(struct sslCheckOptions *options)
 		// Load PKey...
 		if (status != 0)
 		{
-			if (!SSL_CTX_use_PrivateKey_file(options->ctx, options->privateKeyFile, SSL_FILETYPE_PEM))
+			if (!SSL_CTX_use_PrivateKey_file(ctx, options->privateKeyFile, SSL_FILETYPE_PEM))
 			{
-				if (!SSL_CTX_use_PrivateKey_file(options->ctx, options->privateKeyFile, SSL_FILETYPE_ASN1))
+				if (!SSL_CTX_use_PrivateKey_file(ctx, options->privateKeyFile, SSL_FILETYPE_ASN1))
 				{
-					if (!SSL_CTX_use_RSAPrivateKey_file(options->ctx, options->privateKeyFile, SSL_FILETYPE_PEM))
+					if (!SSL_CTX_use_RSAPrivateKey_file(ctx, options->privateKeyFile, SSL_FILETYPE_PEM))
 					{
-						if (!SSL_CTX_use_RSAPrivateKey_file(options->ctx, options->privateKeyFile, SSL_FILETYPE_ASN1))
+						if (!SSL_CTX_use_RSAPrivateKey_file(ctx, options->privateKeyFile, SSL_FILETYPE_ASN1))
 						{
-							printf("%s    Could not configure private key.%s\n", COL_RED, RESET);
+							scanError(options, "    Could not configure private key.");
 							status = 0;
 						}
 					}
@@ -537,26 +1636,26 @@ int loadCerts(struct sslCheckOptions *options)
 			if (!pk12)
 			{
 				status = 0;
-				printf("%s    Could not read PKCS#12 file.%s\n", COL_RED, RESET);
+				scanError(options, "    Could not read PKCS#12 file.");
 			}
 			else
 			{
 				if (!PKCS12_parse(pk12, options->privateKeyPassword, &pkey, &cert, &ca))
 				{
 					status = 0;
-					printf("%s    Error parsing PKCS#12. Are you sure that password was correct?%s\n", COL_RED, RESET);
+					scanError(options, "    Error parsing PKCS#12. Are you sure that password was correct?");
 				}
 				else
 				{
-					if (!SSL_CTX_use_certificate(options->ctx, cert))
+					if (!SSL_CTX_use_certificate(ctx, cert))
 					{
 						status = 0;
-						printf("%s    Could not configure certificate.%s\n", COL_RED, RESET);
+						scanError(options, "    Could not configure certificate.");
 					}
-					if (!SSL_CTX_use_PrivateKey(options->ctx, pkey))
+					if (!SSL_CTX_use_PrivateKey(ctx, pkey))
 					{
 						status = 0;
-						printf("%s    Could not configure private key.%s\n", COL_RED, RESET);
+						scanError(options, "    Could not configure private key.");
 					}
 				}
 				PKCS12_free(pk12);
@@ -565,7 +1664,7 @@ int loadCerts(struct sslCheckOptions *options)
 		}
 		else
 		{
-			printf("%s    Could not open PKCS#12 file.%s\n", COL_RED, RESET);
+			scanError(options, "    Could not open PKCS#12 file.");
 			status = 0;
 		}
 	}
@@ -573,9 +1672,9 @@ int loadCerts(struct sslCheckOptions *options)
 	// Check Cert/Key...
 	if (status != 0)
 	{
-		if (!SSL_CTX_check_private_key(options->ctx))
+		if (!SSL_CTX_check_private_key(ctx))
 		{
-			printf("%s    Prvate key does not match certificate.%s\n", COL_RED, RESET);
+			scanError(options, "    Prvate key does not match certificate.");
 			return false;
 		}
 		else
@@ -586,969 +1685,5801 @@ int loadCerts(struct sslCheckOptions *options)
 }
 
 
-// Test a cipher...
-int testCipher(struct sslCheckOptions *options, struct sslCipher *sslCipherPointer)
+// Take a reference to a trust store...
+void trustStoreReference(X509_STORE *store)
 {
-	// Variables...
-	int cipherStatus;
-	int status = true;
-	int socketDescriptor = 0;
-	SSL *ssl = NULL;
-	BIO *cipherConnectionBio;
-	BIO *stdoutBIO = NULL;
-	int tempInt;
-	char requestBuffer[200];
-	char buffer[50];
-	int resultSize = 0;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	CRYPTO_add(&store->references, 1, CRYPTO_LOCK_X509_STORE);
+#else
+	X509_STORE_up_ref(store);
+#endif
+}
 
-	// Create request buffer...
-	memset(requestBuffer, 0, 200);
-	snprintf(requestBuffer, 199, "GET / HTTP/1.0\r\nUser-Agent: SSLScan\r\nHost: %s\r\n\r\n", options->host);
 
-	// Connect to host
-	socketDescriptor = tcpConnect(options);
-	if (socketDescriptor != 0)
+// Get the trusted CAs...
+//   They are parsed once into a store that every verifying context
+//   shares, with --capath the certificates are looked up in the hashed
+//   directory when a chain needs them instead of being read up front.
+X509_STORE *getTrustStore(struct sslCheckOptions *options)
+{
+	// Variables...
+	X509_STORE *store;
+	const char *cafile = NULL;
+	const char *capath = NULL;
+
+	if (options->trustStore != 0)
+		return options->trustStore;
+
+	if (options->cafile[0] != 0)
+		cafile = options->cafile;
+	if (options->capath[0] != 0)
+		capath = options->capath;
+
+	store = X509_STORE_new();
+	if (store == NULL)
+		return NULL;
+	if (!X509_STORE_load_locations(store, cafile, capath))
 	{
-		if (SSL_CTX_set_cipher_list(options->ctx, sslCipherPointer->name) != 0)
-		{
+		if (capath == NULL)
+			scanError(options, "    ERROR: failed to load trusted CA file:%s.", options->cafile);
+		else
+			scanError(options, "    ERROR: failed to load trusted CA file:%s or directory:%s.", options->cafile, options->capath);
+		X509_STORE_free(store);
+		return NULL;
+	}
+	options->trustStore = store;
+	return store;
+}
 
-			// Create SSL object...
-			ssl = SSL_new(options->ctx);
-			if (ssl != NULL)
-			{
-				// Connect socket and BIO
-				cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
 
-				// Connect SSL and BIO
-				SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+// Free the trust store (the contexts hold references of their own)...
+//   The cached verify results were reached with it, so they go too.
+void freeTrustStore(struct sslCheckOptions *options)
+{
+	if (options->trustStore != 0)
+		X509_STORE_free(options->trustStore);
+	options->trustStore = 0;
+	free(options->verifyCache);
+	options->verifyCache = 0;
+}
 
-				// set SNI Servername
-				if (options->sniEnable == true){
-					if(!SSL_set_tlsext_host_name(ssl,options->sniServername)){
-						status = false;
-						printf("%s    ERROR: Failed to set the SNI servername to %s (SSLv1-3 does not support SNI)%s\n", COL_RED,options->sniServername,RESET);
-					}
-				}
 
-				// add TLS Status reuqest (OCSP)
-				if (options->OCSPStatusRequest == true){
-					if(!SSL_set_tlsext_status_type(ssl, TLSEXT_STATUSTYPE_ocsp)){
-						status = false;
-						printf("%s    ERROR: Failed to set TLS Status request (OCSP stapling)%s\n", COL_RED,RESET);
-					}
-				}
+// Verify a presented chain, or reuse the result for the same chain...
+//   Hosts behind a CDN or with a wildcard certificate present the same
+//   chain over and over, the result only depends on the chain and the
+//   trust store. The key covers the whole chain (leaf first) as the
+//   intermediates decide whether it verifies.
+int verifyCallback(X509_STORE_CTX *storeContext, void *arg)
+{
+	// Variables...
+	struct sslCheckOptions *options = arg;
+	struct verifyCacheEntry *entry;
+	STACK_OF(X509) *chain;
+	EVP_MD_CTX *sha256;
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	unsigned int digestLength;
+	int status;
+	int loop;
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	chain = storeContext->untrusted;
+#else
+	chain = X509_STORE_CTX_get0_untrusted(storeContext);
+#endif
+	if (chain == NULL)
+		return X509_verify_cert(storeContext);
 
-				// Connect SSL over socket
-				cipherStatus = SSL_connect(ssl);
+	// Chain key...
+	sha256 = EVP_MD_CTX_create();
+	if ((sha256 == NULL) || (EVP_DigestInit_ex(sha256, EVP_sha256(), NULL) != 1))
+	{
+		EVP_MD_CTX_destroy(sha256);
+		return X509_verify_cert(storeContext);
+	}
+	for (loop = 0; loop < sk_X509_num(chain); loop++)
+	{
+		if (!X509_digest(sk_X509_value(chain, loop), EVP_sha256(), digest, &digestLength))
+		{
+			EVP_MD_CTX_destroy(sha256);
+			return X509_verify_cert(storeContext);
+		}
+		EVP_DigestUpdate(sha256, digest, digestLength);
+	}
+	status = EVP_DigestFinal_ex(sha256, digest, &digestLength);
+	EVP_MD_CTX_destroy(sha256);
+	if (status != 1)
+		return X509_verify_cert(storeContext);
 
-				// Show Cipher Status
-				if (!((options->noFailed == true) && (cipherStatus != 1)))
-				{
-					if (options->xmlOutput != 0)
-						fprintf(options->xmlOutput, "  <cipher status=\"");
-					if (cipherStatus == 1)
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "accepted\"");
-						if (options->pout == true)
-							printf("|| Accepted || ");
-						else
-							printf("    Accepted  ");
-						if (options->http == true)
-						{
+	if (options->verifyCache == 0)
+	{
+		options->verifyCache = calloc(certificate_cache_size, sizeof(struct verifyCacheEntry));
+		if (options->verifyCache == 0)
+			return X509_verify_cert(storeContext);
+	}
+	entry = options->verifyCache + (digest[0] | (digest[1] << 8)) % certificate_cache_size;
 
-							// Stdout BIO...
-							stdoutBIO = BIO_new(BIO_s_file());
-							BIO_set_fp(stdoutBIO, stdout, BIO_NOCLOSE);
+	// Seen before...
+	if ((entry->used == true) && (memcmp(entry->digest, digest, sizeof(digest)) == 0))
+	{
+		X509_STORE_CTX_set_error(storeContext, entry->verifyResult);
+		return (entry->verifyResult == X509_V_OK);
+	}
 
-							// HTTP Get...
-							SSL_write(ssl, requestBuffer, sizeof(requestBuffer));
-							memset(buffer ,0 , 50);
-							resultSize = SSL_read(ssl, buffer, 49);
-							if (resultSize > 9)
-							{
-								int loop = 0;
-								for (loop = 9; (loop < 49) && (buffer[loop] != 0) && (buffer[loop] != '\r') && (buffer[loop] != '\n'); loop++)
-								{ }
-								buffer[loop] = 0;
-
-								// Output HTTP code...
-								if (options->pout == true)
-									printf("%s || ", buffer + 9);
-								else
-								{
-									printf("%s", buffer + 9);
-									loop = strlen(buffer + 9);
-									while (loop < 17)
-									{
-										loop++;
-										printf(" ");
-									}
-								}
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, " http=\"%s\"", buffer + 9);
-							}
-							else
-							{
-								// Output HTTP code...
-								if (options->pout == true)
-									printf("|| || ");
-								else
-									printf("                 ");
-							}
-						}
-						// FTPS: check for Data Connection Security...
-						else if ((options->ftps == true)&&(options->ftps_dcs == true)){
-							SSL_write(ssl, "PROT P\r\n", 8); // We set the data channel to "Private"...
-							memset(buffer ,0 , 4);
-							resultSize = SSL_read(ssl, buffer, 3);
-							if (resultSize == 3 )
-							{
-								if (atoi(buffer) == 200) // ...and expect to succeed.
-									printf("Data-Channel-Encryption-Support: OK (%s)  ",buffer);
-								else
-									printf("Data-Channel-Encryption-Support: NA (%s)  ",buffer);
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, " data-connection-security-private=\"%s\"", buffer);
-							}
-						}
-						// FTPS: check for Data Connection Security...
-						else if ((options->ftps == true)&&(options->ftps_dcs == true)){
-							SSL_write(ssl, "PROT P\r\n", 8); // We set the data channel to "Private"...
-							memset(buffer ,0 , 4);
-							resultSize = SSL_read(ssl, buffer, 3);
-							if (resultSize == 3 )
-							{
-								if (atoi(buffer) == 200) // ...and expect to succeed.
-									printf("Data-Channel-Encryption-Support: OK (%s)  ",buffer);
-								else
-									printf("Data-Channel-Encryption-Support: NA (%s)  ",buffer);
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, " data-connection-security-private=\"%s\"", buffer);
-							}
-						}
-					}
-					else if (cipherStatus == 0)
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "rejected\"");
-						if (options->http == true)
-						{
-							if (options->pout == true)
-								printf("|| Rejected || N/A || ");
-							else
-								printf("    Rejected  N/A              ");
-						}
-						else
-						{
-							if (options->pout == true)
-								printf("|| Rejected || ");
-							else
-								printf("    Rejected  ");
-						}
-					}
-					else
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "failed\"");
-						if (options->http == true)
-						{
-							if (options->pout == true)
-								printf("|| Failed || N/A || ");
-							else
-								printf("    Failed    N/A              ");
-						}
-						else
-						{
-							if (options->pout == true)
-								printf("|| Failed || ");
-							else
-								printf("    Failed    ");
-						}
-					}
-					if (options->xmlOutput != 0)
-						fprintf(options->xmlOutput, " sslversion=\"");
-#ifndef DISABLE_SSLv2
-					if (sslCipherPointer->sslMethod == SSLv2_client_method())
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "SSLv2\" bits=\"");
-						if (options->pout == true)
-							printf("SSLv2 || ");
-						else
-							printf("SSLv2  ");
-					}
-#endif
-					else if (sslCipherPointer->sslMethod == SSLv3_client_method())
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "SSLv3\" bits=\"");
-						if (options->pout == true)
-							printf("SSLv3 || ");
-						else
-							printf("SSLv3  ");
-					}
-					else if (sslCipherPointer->sslMethod == TLSv1_client_method())
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "TLSv1\" bits=\"");
-						if (options->pout == true)
-							printf("TLSv1 || ");
-						else
-							printf("TLSv1  ");
-					}
-					else if (sslCipherPointer->sslMethod == TLSv1_1_client_method())
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "TLSv1.1\" bits=\"");
-						if (options->pout == true)
-							printf("TLSv1.1 || ");
-						else
-							printf("TLSv1.1  ");
-					}
-					else if (sslCipherPointer->sslMethod == TLSv1_2_client_method())
-					{
-						if (options->xmlOutput != 0)
-							fprintf(options->xmlOutput, "TLSv1.2\" bits=\"");
-						if (options->pout == true)
-							printf("TLSv1.2 || ");
-						else
-							printf("TLSv1.2  ");
-					}
-					else
-					{
-						printf("%sERROR: Could not determine protocol.%s\n", COL_RED, RESET);
-					}
-					if (sslCipherPointer->bits < 10)
-						tempInt = 2;
-					else if (sslCipherPointer->bits < 100)
-						tempInt = 1;
-					else
-						tempInt = 0;
-					if (options->pout == true)
-						printf("%d || ", sslCipherPointer->bits);
-					else
-						printf("%d bits  ", sslCipherPointer->bits);
-					while (tempInt != 0)
-					{
-						tempInt--;
-						printf(" ");
-					}
-					if (options->xmlOutput != 0)
-						fprintf(options->xmlOutput, "%d\" cipher=\"%s\" />\n", sslCipherPointer->bits, sslCipherPointer->name);
-					if (options->pout == true)
-						printf("%s ||\n", sslCipherPointer->name);
-					else
-						printf("%s\n", sslCipherPointer->name);
-				}
+	status = X509_verify_cert(storeContext);
+	memcpy(entry->digest, digest, sizeof(digest));
+	entry->verifyResult = X509_STORE_CTX_get_error(storeContext);
+	entry->used = true;
+	return status;
+}
 
-				// Disconnect SSL over socket
-				if (cipherStatus == 1)
-					SSL_shutdown(ssl);
 
-				// Free SSL object
-				SSL_free(ssl);
-			}
-			else
-			{
-				status = false;
-				printf("%s    ERROR: Could create SSL object.%s\n", COL_RED, RESET);
-			}
-		}
-		else
+// Get a (cached) context object for a method...
+//   The context carries the client certificates and, for verifying
+//   contexts, the trusted CAs. It is kept for the lifetime of the
+//   options so these only have to be loaded once.
+SSL_CTX *getContext(struct sslCheckOptions *options, const SSL_METHOD *sslMethod, int verify)
+{
+	// Variables...
+	struct sslContext *sslContextPointer;
+	X509_STORE *store;
+	SSL_CTX *ctx;
+
+	// Already loaded?
+	for (sslContextPointer = options->contexts; sslContextPointer != 0; sslContextPointer = sslContextPointer->next)
+	{
+		if ((sslContextPointer->sslMethod == sslMethod) && (sslContextPointer->verify == verify))
+			return sslContextPointer->ctx;
+	}
+
+	// Setup Context Object...
+	ctx = SSL_CTX_new(sslMethod);
+	if (ctx == NULL)
+		return NULL;
+
+	// Share the trusted CAs
+	if (verify == true)
+	{
+		store = getTrustStore(options);
+		if (store == NULL)
 		{
-			status = false;
-			printf("%s    ERROR: Could set cipher %s.%s\n", COL_RED, sslCipherPointer->name, RESET);
+			SSL_CTX_free(ctx);
+			return NULL;
 		}
+		trustStoreReference(store);
+		SSL_CTX_set_cert_store(ctx, store);
+		SSL_CTX_set_cert_verify_callback(ctx, verifyCallback, options);
+	}
 
-		// Disconnect from host
-		close(socketDescriptor);
+	// Load Certs if required...
+	if ((options->clientCertsFile != 0) || (options->privateKeyFile != 0))
+	{
+		if (loadCerts(options, ctx) == false)
+		{
+			SSL_CTX_free(ctx);
+			return NULL;
+		}
 	}
 
-	// Could not connect
-	else
-		status = false;
+	// Add to the cache...
+	sslContextPointer = calloc(1, sizeof(struct sslContext));
+	if (sslContextPointer == NULL)
+	{
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	sslContextPointer->sslMethod = sslMethod;
+	sslContextPointer->verify = verify;
+	sslContextPointer->ctx = ctx;
+	sslContextPointer->next = options->contexts;
+	options->contexts = sslContextPointer;
 
-	return status;
+	return ctx;
 }
 
 
-// Test for prefered ciphers
-int defaultCipher(struct sslCheckOptions *options, const SSL_METHOD *sslMethod)
+// Free all cached context objects...
+void freeContexts(struct sslCheckOptions *options)
 {
 	// Variables...
-	int cipherStatus;
-	int status = true;
-	int socketDescriptor = 0;
-	SSL *ssl = NULL;
-	BIO *cipherConnectionBio;
-	int tempInt;
-	int tempInt2;
+	struct sslContext *sslContextPointer;
 
-	// Connect to host
-	socketDescriptor = tcpConnect(options);
-	if (socketDescriptor != 0)
+	while (options->contexts != 0)
 	{
+		sslContextPointer = options->contexts->next;
+		SSL_CTX_free(options->contexts->ctx);
+		free(options->contexts);
+		options->contexts = sslContextPointer;
+	}
+}
 
-		// Setup Context Object...
-		options->ctx = SSL_CTX_new(sslMethod);
-		if (options->ctx != NULL)
-		{
-			if (SSL_CTX_set_cipher_list(options->ctx, "ALL:COMPLEMENTOFALL") != 0)
-			{
 
-				// Load Certs if required...
-				if ((options->clientCertsFile != 0) || (options->privateKeyFile != 0))
-					status = loadCerts(options);
+// Get the ClientHello of a handshake with every cipher (for sweeps)...
+int clientHello(struct sslCheckOptions *options, unsigned char *hello, int size)
+{
+	// Variables...
+	SSL_CTX *ctx;
+	SSL *ssl;
+	BIO *input;
+	BIO *output;
+	char *data;
+	long length = 0;
+
+	ctx = getContext(options, SSLv23_client_method(), false);
+	if (ctx == NULL)
+		return 0;
+	ssl = SSL_new(ctx);
+	if (ssl == NULL)
+		return 0;
 
-				if (status == true)
-				{
-					// Create SSL object...
-					ssl = SSL_new(options->ctx);
-					if (ssl != NULL)
-					{
-						// Connect socket and BIO
-						cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+	// The handshake stops at the ClientHello, written to memory...
+	SSL_set_cipher_list(ssl, "ALL:COMPLEMENTOFALL");
+	input = BIO_new(BIO_s_mem());
+	output = BIO_new(BIO_s_mem());
+	SSL_set_bio(ssl, input, output);
+	SSL_connect(ssl);
+	length = BIO_get_mem_data(output, &data);
+	if ((length > 0) && (length <= size))
+		memcpy(hello, data, length);
+	else
+		length = 0;
 
-						// Connect SSL and BIO
-						SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+	SSL_free(ssl);
+	ERR_clear_error();
+	return length;
+}
 
-						// set SNI Servername
-						if (options->sniEnable == true){
-							if(!SSL_set_tlsext_host_name(ssl,options->sniServername)){
-								status = false;
-								printf("%s    ERROR: Failed to set the SNI servername to %s (SSLv1-3 does not support SNI)%s\n", COL_RED,options->sniServername,RESET);
-							}
-						}
 
-						// add TLS Status reuqest (OCSP)
-						if (options->OCSPStatusRequest == true){
-							if(!SSL_set_tlsext_status_type(ssl, TLSEXT_STATUSTYPE_ocsp)){
-								status = false;
-								printf("%s    ERROR: Failed to set TLS Status request (OCSP stapling)%s\n", COL_RED,RESET);
-							}
-						}
+// Does a reply start with a SSL/TLS record (handshake or alert)?
+int tlsReply(const unsigned char *reply, int size)
+{
+	if ((size < 1) || ((reply[0] != 0x16) && (reply[0] != 0x15)))
+		return false;
+	return ((size < 2) || (reply[1] == 0x03));
+}
 
-						// Connect SSL over socket
-						cipherStatus = SSL_connect(ssl);
-						if (cipherStatus == 1)
-						{
-#ifndef DISABLE_SSLv2
-							if (sslMethod == SSLv2_client_method())
-							{
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  <defaultcipher sslversion=\"SSLv2\" bits=\"");
-								if (options->pout == true)
-									printf("|| SSLv2 || ");
-								else
-									printf("    SSLv2  ");
-							}
-							else
-#endif
-							if (sslMethod == SSLv3_client_method())
-							{
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  <defaultcipher sslversion=\"SSLv3\" bits=\"");
-								if (options->pout == true)
-									printf("|| SSLv3 || ");
-								else
-									printf("    SSLv3  ");
-							}
-							else if (sslMethod == TLSv1_client_method())
-							{
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  <defaultcipher sslversion=\"TLSv1\" bits=\"");
-								if (options->pout == true)
-									printf("|| TLSv1 || ");
-								else
-									printf("    TLSv1  ");
-							}
-							else if (sslMethod == TLSv1_1_client_method())
-							{
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  <defaultcipher sslversion=\"TLSv1\" bits=\"");
-								if (options->pout == true)
-									printf("|| TLSv1.1 || ");
-								else
-									printf("    TLSv1.1  ");
-							}
-							else if (sslMethod == TLSv1_2_client_method())
-							{
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  <defaultcipher sslversion=\"TLSv1\" bits=\"");
-								if (options->pout == true)
-									printf("|| TLSv1.2 || ");
-								else
-									printf("    TLSv1.2  ");
-							}
-							else
-							{
-								printf("%sERROR: Could not determine protocol.%s\n", COL_RED, RESET);
-							}
-							if (SSL_get_cipher_bits(ssl, &tempInt2) < 10)
-								tempInt = 2;
-							else if (SSL_get_cipher_bits(ssl, &tempInt2) < 100)
-								tempInt = 1;
-							else
-								tempInt = 0;
-							if (options->pout == true)
-								printf("%d bits || ", SSL_get_cipher_bits(ssl, &tempInt2));
-							else
-								printf("%d bits  ", SSL_get_cipher_bits(ssl, &tempInt2));
-							while (tempInt != 0)
-							{
-								tempInt--;
-								printf(" ");
-							}
-							if (options->xmlOutput != 0)
-								fprintf(options->xmlOutput, "%d\" cipher=\"%s\" />\n", SSL_get_cipher_bits(ssl, &tempInt2), SSL_get_cipher_name(ssl));
-							if (options->pout == true)
-								printf("%s ||\n", SSL_get_cipher_name(ssl));
-							else
-								printf("%s\n", SSL_get_cipher_name(ssl));
-
-							// Disconnect SSL over socket
-							SSL_shutdown(ssl);
-						}
 
-						// Free SSL object
-						SSL_free(ssl);
-					}
-					else
-					{
-						status = false;
-						printf("%s    ERROR: Could create SSL object.%s\n", COL_RED, RESET);
-					}
+// Sweep with non-blocking sockets and epoll...
+int sweepEpoll(struct sslCheckOptions *options, const struct sockaddr_in *addresses, int count, const unsigned char *hello, int helloSize, struct sweepSlot *slots, char *answered)
+{
+	// Variables...
+	struct epoll_event event;
+	struct epoll_event events[sweep_events];
+	struct sockaddr_in localAddress;
+	struct sweepSlot *slot;
+	long long deadline;
+	long long remaining;
+	int epollDescriptor;
+	int socketError;
+	socklen_t length;
+	int pending = 0;
+	int ready;
+	int loop;
+	int size;
+
+	epollDescriptor = epoll_create1(0);
+	if (epollDescriptor < 0)
+	{
+		scanError(options, "    ERROR: Could not create an epoll instance.");
+		return false;
+	}
+
+	// Start every connect...
+	for (loop = 0; loop < count; loop++)
+	{
+		slot = slots + loop;
+		slot->socketDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		if (slot->socketDescriptor < 0)
+			continue;
+		options->openSockets++;
+		if (options->sourceCount > 0)
+		{
+			memset(&localAddress, 0, sizeof(localAddress));
+			localAddress.sin_family = AF_INET;
+			localAddress.sin_addr = options->sourceAddresses[options->sourceNext];
+			options->sourceNext = (options->sourceNext + 1) % options->sourceCount;
+			bind(slot->socketDescriptor, (struct sockaddr *) &localAddress, sizeof(localAddress));
+		}
+		event.events = EPOLLOUT;
+		event.data.u32 = loop;
+		if (((connect(slot->socketDescriptor, (struct sockaddr *) &addresses[loop], sizeof(struct sockaddr_in)) < 0) && (errno != EINPROGRESS)) || (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, slot->socketDescriptor, &event) < 0))
+		{
+			socketClose(options, slot->socketDescriptor);
+			slot->socketDescriptor = -1;
+			continue;
+		}
+		slot->state = sweep_connect;
+		pending++;
+	}
+
+	// Connected: send the ClientHello. Readable: the first bytes of the reply...
+	deadline = timeMicroseconds() + sweep_timeout;
+	while ((pending > 0) && ((remaining = deadline - timeMicroseconds()) > 0))
+	{
+		ready = epoll_wait(epollDescriptor, events, sweep_events, (remaining + 999) / 1000);
+		for (loop = 0; loop < ready; loop++)
+		{
+			slot = slots + events[loop].data.u32;
+			if (slot->state == sweep_connect)
+			{
+				socketError = 0;
+				length = sizeof(socketError);
+				getsockopt(slot->socketDescriptor, SOL_SOCKET, SO_ERROR, &socketError, &length);
+				if ((socketError == 0) && (send(slot->socketDescriptor, hello, helloSize, MSG_NOSIGNAL) == helloSize))
+				{
+					slot->state = sweep_receive;
+					event.events = EPOLLIN;
+					event.data.u32 = events[loop].data.u32;
+					epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, slot->socketDescriptor, &event);
+					continue;
 				}
 			}
 			else
 			{
-				status = false;
-				printf("%s    ERROR: Could set cipher.%s\n", COL_RED, RESET);
+				size = recv(slot->socketDescriptor, slot->reply, sizeof(slot->reply), MSG_DONTWAIT);
+				if ((size < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+					continue;
+				answered[events[loop].data.u32] = tlsReply(slot->reply, size);
 			}
-			
-			// Free CTX Object
-			SSL_CTX_free(options->ctx);
-		}
-	
-		// Error Creating Context Object
-		else
-		{
-			status = false;
-			printf("%sERROR: Could not create CTX object.%s\n", COL_RED, RESET);
+			socketClose(options, slot->socketDescriptor);
+			slot->socketDescriptor = -1;
+			pending--;
 		}
+	}
+
+	// Out of time...
+	for (loop = 0; loop < count; loop++)
+	{
+		if (slots[loop].socketDescriptor >= 0)
+			socketClose(options, slots[loop].socketDescriptor);
+	}
+	close(epollDescriptor);
+	return true;
+}
+
+
+#ifdef WITH_IO_URING
+// io_uring submission and completion rings (see io_uring_setup(2))...
+struct sweepRing
+{
+	int ringDescriptor;
+	void *sqRing;
+	size_t sqRingSize;
+	void *cqRing;
+	size_t cqRingSize;
+	struct io_uring_sqe *sqes;
+	size_t sqesSize;
+	unsigned int *sqHead;
+	unsigned int *sqTail;
+	unsigned int *sqArray;
+	unsigned int sqMask;
+	unsigned int sqEntries;
+	unsigned int sqQueued;
+	unsigned int *cqHead;
+	unsigned int *cqTail;
+	unsigned int cqMask;
+	struct io_uring_cqe *cqes;
+};
+
+
+// Unmap and close the rings...
+void ringClose(struct sweepRing *ring)
+{
+	if ((ring->sqes != 0) && (ring->sqes != MAP_FAILED))
+		munmap(ring->sqes, ring->sqesSize);
+	if ((ring->cqRing != 0) && (ring->cqRing != MAP_FAILED) && (ring->cqRing != ring->sqRing))
+		munmap(ring->cqRing, ring->cqRingSize);
+	if ((ring->sqRing != 0) && (ring->sqRing != MAP_FAILED))
+		munmap(ring->sqRing, ring->sqRingSize);
+	close(ring->ringDescriptor);
+}
+
+
+// Set up the rings with a fixed file slot per endpoint...
+//   False if the kernel has no io_uring or cannot create sockets from
+//   it (Linux 5.19), the sweep then falls back to epoll.
+int ringOpen(struct sweepRing *ring, unsigned int entries, int files)
+{
+	// Variables...
+	struct io_uring_params params;
+	struct io_uring_probe *probe;
+	int *fileTable;
+	int status;
+	int loop;
+
+	memset(ring, 0, sizeof(struct sweepRing));
+	memset(&params, 0, sizeof(params));
+	ring->ringDescriptor = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->ringDescriptor < 0)
+		return false;
+
+	// Map the rings...
+	ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) && (ring->cqRingSize > ring->sqRingSize))
+		ring->sqRingSize = ring->cqRingSize;
+	ring->sqRing = mmap(0, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringDescriptor, IORING_OFF_SQ_RING);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cqRing = ring->sqRing;
+	else
+		ring->cqRing = mmap(0, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringDescriptor, IORING_OFF_CQ_RING);
+	ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(0, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringDescriptor, IORING_OFF_SQES);
+	if ((ring->sqRing == MAP_FAILED) || (ring->cqRing == MAP_FAILED) || (ring->sqes == MAP_FAILED))
+	{
+		ringClose(ring);
+		return false;
+	}
+	ring->sqHead = (unsigned int *)((char *)ring->sqRing + params.sq_off.head);
+	ring->sqTail = (unsigned int *)((char *)ring->sqRing + params.sq_off.tail);
+	ring->sqArray = (unsigned int *)((char *)ring->sqRing + params.sq_off.array);
+	ring->sqMask = *(unsigned int *)((char *)ring->sqRing + params.sq_off.ring_mask);
+	ring->sqEntries = params.sq_entries;
+	ring->cqHead = (unsigned int *)((char *)ring->cqRing + params.cq_off.head);
+	ring->cqTail = (unsigned int *)((char *)ring->cqRing + params.cq_off.tail);
+	ring->cqMask = *(unsigned int *)((char *)ring->cqRing + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cqRing + params.cq_off.cqes);
+
+	// Sockets are created into fixed file slots, without descriptors...
+	probe = calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+	status = (probe != NULL) && (syscall(__NR_io_uring_register, ring->ringDescriptor, IORING_REGISTER_PROBE, probe, 256) == 0) && (probe->last_op >= IORING_OP_SOCKET) && (probe->ops[IORING_OP_SOCKET].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	fileTable = malloc(files * sizeof(int));
+	if ((status == true) && (fileTable != NULL))
+	{
+		for (loop = 0; loop < files; loop++)
+			fileTable[loop] = -1;
+		status = (syscall(__NR_io_uring_register, ring->ringDescriptor, IORING_REGISTER_FILES, fileTable, files) == 0);
+	}
+	else
+		status = false;
+	free(fileTable);
+
+	if (status == false)
+		ringClose(ring);
+	return status;
+}
+
+
+// Queue a submission (0 if the ring is full)...
+struct io_uring_sqe *ringQueue(struct sweepRing *ring, int opcode, unsigned long long userData)
+{
+	// Variables...
+	struct io_uring_sqe *sqe;
+	unsigned int tail = *ring->sqTail + ring->sqQueued;
+	unsigned int index = tail & ring->sqMask;
+
+	if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->sqEntries)
+		return 0;
+	sqe = ring->sqes + index;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = opcode;
+	sqe->user_data = userData;
+	ring->sqArray[index] = index;
+	ring->sqQueued++;
+	return sqe;
+}
+
+
+// Submit the queued requests, wait for completions (timeout in microseconds)...
+int ringSubmit(struct sweepRing *ring, unsigned int waitFor, long long timeout)
+{
+	// Variables...
+	struct io_uring_getevents_arg argument;
+	struct __kernel_timespec timespec;
+	int submitted;
+
+	memset(&argument, 0, sizeof(argument));
+	timespec.tv_sec = timeout / 1000000;
+	timespec.tv_nsec = (timeout % 1000000) * 1000;
+	argument.ts = (unsigned long long)(unsigned long)&timespec;
+	__atomic_store_n(ring->sqTail, *ring->sqTail + ring->sqQueued, __ATOMIC_RELEASE);
+	do
+		submitted = syscall(__NR_io_uring_enter, ring->ringDescriptor, ring->sqQueued, waitFor, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof(argument));
+	while ((submitted < 0) && (errno == EINTR));
+	if ((submitted < 0) && (errno != ETIME))
+		return false;
+	if (submitted > 0)
+		ring->sqQueued -= submitted;
+	return true;
+}
+
+
+// Sweep with io_uring...
+//   Every endpoint is a linked chain socket -> connect -> send -> recv on a
+//   fixed file slot, all submitted with one system call that also waits
+//   for them. What is left when the time is up is cancelled, the closes
+//   go out as a second batch.
+int sweepRing(struct sslCheckOptions *options, const struct sockaddr_in *addresses, int count, const unsigned char *hello, int helloSize, struct sweepSlot *slots, char *answered)
+{
+	// Variables...
+	struct sweepRing ring;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	unsigned int head;
+	long long deadline;
+	long long remaining;
+	int expected = 4 * count;
+	int completed = 0;
+	int cancelled = false;
+	int opened = 0;
+	int slot;
+	int loop;
+
+	if (ringOpen(&ring, 4 * count + 1, count) == false)
+		return false;
+
+	for (loop = 0; loop < count; loop++)
+	{
+		sqe = ringQueue(&ring, IORING_OP_SOCKET, sweep_user(loop, sweep_socket));
+		sqe->fd = AF_INET;
+		sqe->off = SOCK_STREAM;
+		sqe->file_index = loop + 1;
+		sqe->flags = IOSQE_IO_LINK;
+		sqe = ringQueue(&ring, IORING_OP_CONNECT, sweep_user(loop, sweep_connect));
+		sqe->fd = loop;
+		sqe->addr = (unsigned long long)(unsigned long)(addresses + loop);
+		sqe->off = sizeof(struct sockaddr_in);
+		sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+		sqe = ringQueue(&ring, IORING_OP_SEND, sweep_user(loop, sweep_send));
+		sqe->fd = loop;
+		sqe->addr = (unsigned long long)(unsigned long)hello;
+		sqe->len = helloSize;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+		sqe = ringQueue(&ring, IORING_OP_RECV, sweep_user(loop, sweep_receive));
+		sqe->fd = loop;
+		sqe->addr = (unsigned long long)(unsigned long)slots[loop].reply;
+		sqe->len = sizeof(slots[loop].reply);
+		sqe->flags = IOSQE_FIXED_FILE;
+	}
+
+	// Reap, cancel whatever is left when the time is up...
+	deadline = timeMicroseconds() + sweep_timeout;
+	while (completed < expected)
+	{
+		remaining = deadline - timeMicroseconds();
+		if (remaining <= 0)
+		{
+			if (cancelled == true)
+				break;
+			sqe = ringQueue(&ring, IORING_OP_ASYNC_CANCEL, sweep_user(count, sweep_cancel));
+			sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+			expected++;
+			cancelled = true;
+			deadline = timeMicroseconds() + sweep_timeout;
+			remaining = sweep_timeout;
+		}
+		if (ringSubmit(&ring, expected - completed, remaining) == false)
+			break;
+
+		head = *ring.cqHead;
+		while (head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE))
+		{
+			cqe = ring.cqes + (head & ring.cqMask);
+			slot = cqe->user_data >> 3;
+			if (((cqe->user_data & 7) == sweep_socket) && (cqe->res >= 0))
+			{
+				slots[slot].state = sweep_close;
+				opened++;
+			}
+			else if ((cqe->user_data & 7) == sweep_receive)
+				answered[slot] = tlsReply(slots[slot].reply, cqe->res);
+			completed++;
+			head++;
+		}
+		__atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	// Close the sockets, as one batch...
+	for (loop = 0; loop < count; loop++)
+	{
+		if (slots[loop].state == sweep_close)
+		{
+			sqe = ringQueue(&ring, IORING_OP_CLOSE, sweep_user(loop, sweep_close));
+			sqe->file_index = loop + 1;
+		}
+	}
+	if (opened > 0)
+		ringSubmit(&ring, opened, sweep_timeout);
+	ringClose(&ring);
+	return (completed > 0);
+}
+#endif
+
+
+// Remember the alert a server sent (SSL info callback)...
+void alertCallback(const SSL *ssl, int where, int ret)
+{
+	// Variables...
+	int *alert = SSL_get_app_data(ssl);
+
+	if (((where & SSL_CB_READ_ALERT) == SSL_CB_READ_ALERT) && (alert != 0))
+		*alert = ret;
+}
+
+
+// Classify a handshake that did not complete (before errno changes)...
+int handshakeFailure(SSL *ssl, int cipherStatus, int alert)
+{
+	if (alert != 0)
+		return failure_alert;
+	switch (SSL_get_error(ssl, cipherStatus))
+	{
+		case SSL_ERROR_SYSCALL:
+			return (cipherStatus == 0) ? failure_closed : socketFailure(errno);
+		case SSL_ERROR_WANT_READ:
+		case SSL_ERROR_WANT_WRITE:
+			return failure_timeout;
+		case SSL_ERROR_ZERO_RETURN:
+			return failure_closed;
+		default:
+			return failure_protocol;
+	}
+}
+
+
+// Ask for the HTTP status of the host on an accepted connection (--http)...
+//   Only the status line is read, the host keeps it for every cipher.
+void httpRequest(struct sslCheckOptions *options, SSL *ssl, const struct sslCipherResult *result)
+{
+	// Variables...
+	char request[BUFFERSIZE];
+	char line[http_status_max + 16];
+	char *status;
+	int length;
+	int used = 0;
+	int size;
+	struct traceSpan span;
+
+	options->httpAttempts++;
+	traceBegin(options, &span, phase_http);
+	length = snprintf(request, sizeof(request), "GET / HTTP/1.0\r\nUser-Agent: SSLScan\r\nHost: %s\r\n\r\n", options->host);
+	if ((length > 0) && (length < sizeof(request)) && (SSL_write(ssl, request, length) == length))
+	{
+		// Until the end of the status line, or as much of it as is kept...
+		while (used < sizeof(line) - 1)
+		{
+			size = SSL_read(ssl, line + used, sizeof(line) - 1 - used);
+			if (size <= 0)
+				break;
+			used += size;
+			if (memchr(line + used - size, '\n', size) != NULL)
+				break;
+		}
+	}
+	line[used] = 0;
+	line[strcspn(line, "\r\n")] = 0;
+
+	// "HTTP/1.1 200 OK"...
+	status = strchr(line, ' ');
+	if ((strncmp(line, "HTTP/", 5) == 0) && (status != NULL) && (status[1] != 0))
+	{
+		snprintf(options->httpStatus, sizeof(options->httpStatus), "%s", status + 1);
+		options->httpCode = atoi(options->httpStatus);
+	}
+	traceEnd(options, &span, result->cipher, result->version, (options->httpStatus[0] != 0) ? "ok" : "failed");
+}
+
+
+// Probe a cipher once...
+//   Returns false if no handshake could be made, result->failure tells why.
+int cipherProbe(struct sslCheckOptions *options, SSL_CTX *ctx, const struct sslCipher *sslCipherPointer, struct sslCipherResult *result, char *buffer)
+{
+	// Variables...
+	int cipherStatus;
+	int cipherSet;
+	int status = false;
+	int alert = 0;
+	int socketDescriptor = 0;
+	SSL *ssl = NULL;
+	BIO *cipherConnectionBio;
+	const SSL_CIPHER *cipher;
+	int resultSize = 0;
+	int loop;
+	long long connectStart;
+	long long handshakeStart;
+	struct traceSpan span;
+
+	// Cipher
+	memset(result, 0, sizeof(struct sslCipherResult));
+	result->status = probe_failed;
+	result->failure = failure_local;
+	result->sslVersion = sslCipherPointer->sslVersion;
+	result->version = sslVersionName(sslCipherPointer->sslVersion);
+	result->cipher = sslCipherPointer->name;
+	result->bits = sslCipherPointer->bits;
+	result->cipherId = sslCipherPointer->id;
+
+	// Connect to host
+	metricsAdd(options, probesStarted, 1);
+	connectStart = timeMicroseconds();
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor != 0)
+	{
+		// Create SSL object...
+		ssl = SSL_new(ctx);
+		if (ssl != NULL)
+		{
+			// The cipher is set on the SSL object, the context stays shared
+#ifdef TLS1_3_VERSION
+			if (sslCipherPointer->sslVersion == tls_v1_3)
+				cipherSet = (SSL_set_min_proto_version(ssl, TLS1_3_VERSION) == 1) && (SSL_set_max_proto_version(ssl, TLS1_3_VERSION) == 1)
+					&& (SSL_set_ciphersuites(ssl, sslCipherPointer->name) == 1);
+			else
+#endif
+				cipherSet = (SSL_set_cipher_list(ssl, sslCipherPointer->name) != 0);
+			if (cipherSet == true)
+			{
+				// Connect socket and BIO
+				cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+
+				// Connect SSL and BIO
+				SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+
+				// Alerts tell a rejection from a failure
+				SSL_set_app_data(ssl, &alert);
+				SSL_set_info_callback(ssl, alertCallback);
+
+				// set SNI Servername
+				if (options->sniEnable == true){
+					if(!SSL_set_tlsext_host_name(ssl,options->sniServername)){
+						scanError(options, "    ERROR: Failed to set the SNI servername to %s (SSLv1-3 does not support SNI)", options->sniServername);
+					}
+				}
+
+				// add TLS Status reuqest (OCSP)
+				if (options->OCSPStatusRequest == true){
+					if(!SSL_set_tlsext_status_type(ssl, TLSEXT_STATUSTYPE_ocsp)){
+						scanError(options, "    ERROR: Failed to set TLS Status request (OCSP stapling)");
+					}
+				}
+
+
+				// Connect SSL over socket
+				traceBegin(options, &span, phase_handshake);
+				handshakeStart = timeMicroseconds();
+				cipherStatus = SSL_connect(ssl);
+				result->failure = (cipherStatus == 1) ? failure_none : handshakeFailure(ssl, cipherStatus, alert);
+				status = true;
+
+				// Cipher Status, OpenSSL 1.1+ returns -1 for an alert too
+				if (cipherStatus == 1)
+					result->status = probe_accepted;
+				else if ((cipherStatus == 0) || (result->failure == failure_alert))
+					result->status = probe_rejected;
+				else
+					result->status = probe_failed;
+				metricsProbe(options, (result->status == probe_accepted) ? 1 : ((result->status == probe_rejected) ? 0 : -1));
+				traceEnd(options, &span, sslCipherPointer->name, result->version, (result->status == probe_accepted) ? "accepted" : ((result->status == probe_rejected) ? "rejected" : "failed"));
+				result->alert = (alert != 0) ? SSL_alert_desc_string_long(alert) : 0;
+				result->connectTime = handshakeStart - connectStart;
+				result->handshakeTime = timeMicroseconds() - handshakeStart;
+				if (cipherStatus == 1)
+				{
+					// TLS 1.3 offers several suites, the server picked one
+					if (sslCipherPointer->sslVersion == tls_v1_3)
+					{
+						cipher = SSL_get_current_cipher(ssl);
+						result->cipher = SSL_CIPHER_get_name(cipher);
+						result->bits = SSL_CIPHER_get_bits(cipher, &loop);
+						result->cipherId = SSL_CIPHER_get_id(cipher);
+					}
+
+					if (options->http == true)
+					{
+						// HTTP Get, on the first connection that can answer...
+						if ((options->httpStatus[0] == 0) && (options->httpAttempts < http_attempts_max))
+							httpRequest(options, ssl, result);
+						if (options->httpStatus[0] != 0)
+						{
+							result->httpStatus = options->httpStatus;
+							result->httpCode = options->httpCode;
+						}
+					}
+					// FTPS: check for Data Connection Security...
+					else if ((options->ftps == true)&&(options->ftps_dcs == true)){
+						SSL_write(ssl, "PROT P\r\n", 8); // We set the data channel to "Private"...
+						memset(buffer ,0 , 4);
+						resultSize = SSL_read(ssl, buffer, 3);
+						if (resultSize == 3 )
+							result->dataChannel = buffer;
+					}
+
+					// Disconnect SSL over socket
+					SSL_shutdown(ssl);
+				}
+			}
+			else
+				scanError(options, "    ERROR: Could set cipher %s.", sslCipherPointer->name);
+
+			// Free SSL object
+			SSL_free(ssl);
+		}
+		else
+			scanError(options, "    ERROR: Could create SSL object.");
+
+		// Disconnect from host
+		tcpClose(options, socketDescriptor);
+	}
+
+	// Could not connect
+	else
+	{
+		result->failure = options->failure;
+		metricsAdd(options, probesFailed, 1);
+	}
+
+	return status;
+}
+
+
+// Protocols of the key exchange enumeration...
+const int exchangeVersions[exchange_versions] = { tls_v1, tls_v1_1, tls_v1_2, tls_v1_3 };
+
+
+// Remember the first accepted cipher of a protocol that signs an ECDHE
+// key exchange (any TLS 1.3 suite does), for the key exchange enumeration...
+void exchangeCipher(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	// Variables...
+	int loop;
+
+	if (result->status != probe_accepted)
+		return;
+	if ((result->sslVersion != tls_v1_3) && (strncmp(result->cipher, "ECDHE-RSA-", 10) != 0) && (strncmp(result->cipher, "ECDHE-ECDSA-", 12) != 0))
+		return;
+	for (loop = 0; loop < exchange_versions; loop++)
+	{
+		if ((exchangeVersions[loop] == result->sslVersion) && (options->exchangeCiphers[loop] == 0))
+			options->exchangeCiphers[loop] = result->cipher;
+	}
+}
+
+
+// Test a cipher, retrying transient handshake failures...
+//   Returns false if no handshake could be made, or only one that failed
+//   transiently.
+int testCipher(struct sslCheckOptions *options, SSL_CTX *ctx, const struct sslCipher *sslCipherPointer)
+{
+	// Variables...
+	struct sslCipherResult result;
+	char buffer[50];
+	int status;
+	int attempt;
+
+	// Connects are retried by tcpConnect() already...
+	for (attempt = 0; ; attempt++)
+	{
+		status = cipherProbe(options, ctx, sslCipherPointer, &result, buffer);
+		if ((status == false) || (retryProbe(options, result.failure, attempt) == false))
+			break;
+	}
+	result.retries = attempt;
+
+	if (options->callbacks.cipher != 0)
+		options->callbacks.cipher(options->userData, &result);
+	exchangeCipher(options, &result);
+	if (result.status == probe_accepted)
+		options->acceptedVersions |= result.sslVersion;
+
+	// A transient failure that outlasted the retries counts as no handshake...
+	if ((result.failure != failure_none) && (result.failure <= failure_transient))
+		return false;
+	return status;
+}
+
+
+// Test the TLS 1.3 suites by elimination...
+//   Every handshake offers the suites that were not accepted yet and the
+//   server picks one of them, until it rejects the rest. So the suites cost
+//   a handshake each that is accepted, plus one. The first pick is the
+//   preferred suite, it is kept for the preferred ciphers. Returns false
+//   like testCipher().
+int testTls13(struct sslCheckOptions *options)
+{
+	// Variables...
+	struct sslCipher *sslCipherPointer;
+	struct sslCipher offer;
+	struct sslCipherResult result;
+	unsigned long accepted[tls13_suites_max];
+	char suites[BUFFERSIZE];
+	char buffer[50];
+	SSL_CTX *ctx;
+	int acceptedCount = 0;
+	int status = true;
+	int attempt;
+	int loop;
+
+	memset(&result, 0, sizeof(struct sslCipherResult));
+	ctx = getContext(options, sslVersionMethod(tls_v1_3), false);
+	if (ctx == NULL)
+	{
+		scanError(options, "ERROR: Could not create CTX object.");
+		return false;
+	}
+
+	memset(&offer, 0, sizeof(struct sslCipher));
+	offer.name = suites;
+	offer.sslMethod = sslVersionMethod(tls_v1_3);
+	offer.sslVersion = tls_v1_3;
+	while (acceptedCount < tls13_suites_max)
+	{
+		// The suites not accepted yet...
+		suites[0] = 0;
+		for (sslCipherPointer = __atomic_load_n(&cipherCatalog, __ATOMIC_ACQUIRE); sslCipherPointer != 0; sslCipherPointer = sslCipherPointer->next)
+		{
+			if (sslCipherPointer->sslVersion != tls_v1_3)
+				continue;
+			for (loop = 0; (loop < acceptedCount) && (accepted[loop] != sslCipherPointer->id); loop++)
+				;
+			if ((loop == acceptedCount) && (strlen(suites) + strlen(sslCipherPointer->name) + 2 < sizeof(suites)))
+			{
+				if (suites[0] != 0)
+					strcat(suites, ":");
+				strcat(suites, sslCipherPointer->name);
+			}
+		}
+		if (suites[0] == 0)
+			break;
+
+		// Offer them, connects are retried by tcpConnect() already...
+		for (attempt = 0; ; attempt++)
+		{
+			status = cipherProbe(options, ctx, &offer, &result, buffer);
+			if ((status == false) || (retryProbe(options, result.failure, attempt) == false))
+				break;
+		}
+		result.retries = attempt;
+		if (result.status != probe_accepted)
+			break;
+
+		// A suite that was not offered would be picked again and again...
+		for (loop = 0; (loop < acceptedCount) && (accepted[loop] != result.cipherId); loop++)
+			;
+		if (loop < acceptedCount)
+			break;
+		accepted[acceptedCount++] = result.cipherId;
+		if (acceptedCount == 1)
+		{
+			memcpy(&options->tls13Preferred, &result, sizeof(struct sslCipherResult));
+			options->tls13Preferred.httpStatus = 0;
+			options->tls13Preferred.dataChannel = 0;
+			options->tls13Preferred.httpCode = 0;
+		}
+		if (options->callbacks.cipher != 0)
+			options->callbacks.cipher(options->userData, &result);
+		exchangeCipher(options, &result);
+		options->acceptedVersions |= tls_v1_3;
+	}
+
+	// The suites left got the answer to the last offer...
+	for (sslCipherPointer = __atomic_load_n(&cipherCatalog, __ATOMIC_ACQUIRE); sslCipherPointer != 0; sslCipherPointer = sslCipherPointer->next)
+	{
+		if (sslCipherPointer->sslVersion != tls_v1_3)
+			continue;
+		for (loop = 0; (loop < acceptedCount) && (accepted[loop] != sslCipherPointer->id); loop++)
+			;
+		if (loop < acceptedCount)
+			continue;
+		result.status = (result.status == probe_accepted) ? probe_rejected : result.status;
+		result.cipher = sslCipherPointer->name;
+		result.bits = sslCipherPointer->bits;
+		result.cipherId = sslCipherPointer->id;
+		result.httpStatus = 0;
+		result.dataChannel = 0;
+		result.httpCode = 0;
+		if (options->callbacks.cipher != 0)
+			options->callbacks.cipher(options->userData, &result);
+	}
+
+	// A transient failure that outlasted the retries counts as no handshake...
+	if ((result.failure != failure_none) && (result.failure <= failure_transient))
+		return false;
+	return status;
+}
+
+
+// SSLv2 cipher specs (the id is 0x02 and the 3 byte spec)...
+const struct legacyCipher legacySSLv2[] = {
+	{ 0x02010080, "RC4-MD5", 128 },
+	{ 0x02020080, "EXP-RC4-MD5", 40 },
+	{ 0x02030080, "RC2-CBC-MD5", 128 },
+	{ 0x02040080, "EXP-RC2-CBC-MD5", 40 },
+	{ 0x02050080, "IDEA-CBC-MD5", 128 },
+	{ 0x02060040, "DES-CBC-MD5", 56 },
+	{ 0x020700c0, "DES-CBC3-MD5", 168 },
+	{ 0, 0, 0 } };
+
+// SSLv3 cipher suites (the id is 0x0300 and the 2 byte suite)...
+const struct legacyCipher legacySSLv3[] = {
+	{ 0x03000001, "NULL-MD5", 0 },
+	{ 0x03000002, "NULL-SHA", 0 },
+	{ 0x03000003, "EXP-RC4-MD5", 40 },
+	{ 0x03000004, "RC4-MD5", 128 },
+	{ 0x03000005, "RC4-SHA", 128 },
+	{ 0x03000006, "EXP-RC2-CBC-MD5", 40 },
+	{ 0x03000007, "IDEA-CBC-SHA", 128 },
+	{ 0x03000008, "EXP-DES-CBC-SHA", 40 },
+	{ 0x03000009, "DES-CBC-SHA", 56 },
+	{ 0x0300000a, "DES-CBC3-SHA", 168 },
+	{ 0x0300000b, "EXP-DH-DSS-DES-CBC-SHA", 40 },
+	{ 0x0300000c, "DH-DSS-DES-CBC-SHA", 56 },
+	{ 0x0300000d, "DH-DSS-DES-CBC3-SHA", 168 },
+	{ 0x0300000e, "EXP-DH-RSA-DES-CBC-SHA", 40 },
+	{ 0x0300000f, "DH-RSA-DES-CBC-SHA", 56 },
+	{ 0x03000010, "DH-RSA-DES-CBC3-SHA", 168 },
+	{ 0x03000011, "EXP-EDH-DSS-DES-CBC-SHA", 40 },
+	{ 0x03000012, "EDH-DSS-DES-CBC-SHA", 56 },
+	{ 0x03000013, "EDH-DSS-DES-CBC3-SHA", 168 },
+	{ 0x03000014, "EXP-EDH-RSA-DES-CBC-SHA", 40 },
+	{ 0x03000015, "EDH-RSA-DES-CBC-SHA", 56 },
+	{ 0x03000016, "EDH-RSA-DES-CBC3-SHA", 168 },
+	{ 0x03000017, "EXP-ADH-RC4-MD5", 40 },
+	{ 0x03000018, "ADH-RC4-MD5", 128 },
+	{ 0x03000019, "EXP-ADH-DES-CBC-SHA", 40 },
+	{ 0x0300001a, "ADH-DES-CBC-SHA", 56 },
+	{ 0x0300001b, "ADH-DES-CBC3-SHA", 168 },
+	{ 0x0300002f, "AES128-SHA", 128 },
+	{ 0x03000032, "DHE-DSS-AES128-SHA", 128 },
+	{ 0x03000033, "DHE-RSA-AES128-SHA", 128 },
+	{ 0x03000034, "ADH-AES128-SHA", 128 },
+	{ 0x03000035, "AES256-SHA", 256 },
+	{ 0x03000038, "DHE-DSS-AES256-SHA", 256 },
+	{ 0x03000039, "DHE-RSA-AES256-SHA", 256 },
+	{ 0x0300003a, "ADH-AES256-SHA", 256 },
+	{ 0x03000041, "CAMELLIA128-SHA", 128 },
+	{ 0x03000084, "CAMELLIA256-SHA", 256 },
+	{ 0x03000096, "SEED-SHA", 128 },
+	{ 0x0300c007, "ECDHE-ECDSA-RC4-SHA", 128 },
+	{ 0x0300c008, "ECDHE-ECDSA-DES-CBC3-SHA", 168 },
+	{ 0x0300c009, "ECDHE-ECDSA-AES128-SHA", 128 },
+	{ 0x0300c00a, "ECDHE-ECDSA-AES256-SHA", 256 },
+	{ 0x0300c011, "ECDHE-RSA-RC4-SHA", 128 },
+	{ 0x0300c012, "ECDHE-RSA-DES-CBC3-SHA", 168 },
+	{ 0x0300c013, "ECDHE-RSA-AES128-SHA", 128 },
+	{ 0x0300c014, "ECDHE-RSA-AES256-SHA", 256 },
+	{ 0, 0, 0 } };
+
+
+// Build a SSLv2 CLIENT-HELLO or a SSLv3 ClientHello with the ciphers not
+// accepted yet (0 if there are none)...
+int legacyHello(int sslVersion, const char *accepted, unsigned char *hello, int size)
+{
+	// Variables...
+	const struct legacyCipher *ciphers = (sslVersion == ssl_v2) ? legacySSLv2 : legacySSLv3;
+	int specSize = (sslVersion == ssl_v2) ? 3 : 2;
+	int header = (sslVersion == ssl_v2) ? 11 : 5 + 4 + 2 + 32 + 1 + 2;
+	int length = header;
+	int loop;
+
+	for (loop = 0; ciphers[loop].name != 0; loop++)
+	{
+		if ((accepted[loop] == true) || (length + specSize + 16 + 2 > size))
+			continue;
+		if (specSize == 3)
+			hello[length++] = (ciphers[loop].id >> 16) & 0xff;
+		hello[length++] = (ciphers[loop].id >> 8) & 0xff;
+		hello[length++] = ciphers[loop].id & 0xff;
+	}
+	if (length == header)
+		return 0;
+
+	if (sslVersion == ssl_v2)
+	{
+		// Challenge...
+		for (loop = 0; loop < 16; loop++)
+			hello[length++] = rand() & 0xff;
+
+		// Two byte record header, CLIENT-HELLO version 2, cipher specs,
+		// no session id, 16 byte challenge
+		hello[0] = 0x80 | ((length - 2) >> 8);
+		hello[1] = (length - 2) & 0xff;
+		hello[2] = 1;
+		hello[3] = 0x00;
+		hello[4] = 0x02;
+		hello[5] = (length - header) >> 8;
+		hello[6] = (length - header) & 0xff;
+		hello[7] = 0;
+		hello[8] = 0;
+		hello[9] = 0;
+		hello[10] = 16;
+		return length;
+	}
+
+	// Handshake record, ClientHello 3.0, random, no session id, suites...
+	hello[0] = 0x16;
+	hello[1] = 0x03;
+	hello[2] = 0x00;
+	hello[3] = (length + 2 - 5) >> 8;
+	hello[4] = (length + 2 - 5) & 0xff;
+	hello[5] = 1;
+	hello[6] = 0;
+	hello[7] = (length + 2 - 9) >> 8;
+	hello[8] = (length + 2 - 9) & 0xff;
+	hello[9] = 0x03;
+	hello[10] = 0x00;
+	for (loop = 11; loop < 43; loop++)
+		hello[loop] = rand() & 0xff;
+	hello[43] = 0;
+	hello[44] = (length - header) >> 8;
+	hello[45] = (length - header) & 0xff;
+
+	// ...and the null compression method
+	hello[length++] = 1;
+	hello[length++] = 0;
+	return length;
+}
+
+
+// Send a legacy hello and read the first record of the answer...
+//   Returns the bytes read (0 if the server closed without answering), or
+//   -1 if the host could not be reached or did not answer in time.
+int legacyExchange(struct sslCheckOptions *options, const unsigned char *hello, int helloSize, unsigned char *reply, int size)
+{
+	// Variables...
+	int socketDescriptor;
+	int received = 0;
+	int wanted = 5;
+	int length = 0;
+
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor == 0)
+		return -1;
+
+	if (send(socketDescriptor, hello, helloSize, MSG_NOSIGNAL) == helloSize)
+	{
+		// A SSLv2 record has a 2 byte header, a SSL/TLS record a 5 byte one
+		while (received < wanted)
+		{
+			length = recv(socketDescriptor, reply + received, wanted - received, 0);
+			if ((length < 0) && (received == 0) && (socketFailure(errno) == failure_timeout))
+				received = -1;
+			if (length <= 0)
+				break;
+			received += length;
+			if ((received >= 2) && ((reply[0] & 0x80) != 0))
+				wanted = 2 + (((reply[0] & 0x7f) << 8) | reply[1]);
+			else if (received >= 5)
+				wanted = 5 + ((reply[3] << 8) | reply[4]);
+			if (wanted > size)
+				wanted = size;
+		}
+	}
+
+	tcpClose(options, socketDescriptor);
+	if (received < 0)
+		options->failure = failure_timeout;
+	return received;
+}
+
+
+// Read the ciphers accepted in the answer to a legacy hello...
+//   A SSLv2 SERVER-HELLO lists all cipher specs the server shares, a SSLv3
+//   ServerHello names one suite. They are added to order. Returns
+//   probe_accepted if the answer added a cipher, or probe_rejected for an
+//   alert, an error, another protocol version, no answer or only ciphers
+//   that were accepted before or not offered.
+int legacyReply(int sslVersion, const unsigned char *reply, int size, char *accepted, int *order, int *orderCount, int *failure)
+{
+	// Variables...
+	const struct legacyCipher *ciphers = (sslVersion == ssl_v2) ? legacySSLv2 : legacySSLv3;
+	const unsigned char *specs;
+	unsigned long id;
+	int specsLength;
+	int offset;
+	int loop;
+	int known = *orderCount;
+
+	*failure = ((size >= 1) && (reply[0] == 0x15)) ? failure_alert : ((size == 0) ? failure_closed : failure_protocol);
+
+	// SSLv2: SERVER-HELLO, version 2, certificate, cipher specs, connection id
+	if (sslVersion == ssl_v2)
+	{
+		if ((size < 13) || ((reply[0] & 0x80) == 0) || (reply[2] != 4) || (reply[5] != 0x00) || (reply[6] != 0x02))
+			return probe_rejected;
+		offset = 13 + ((reply[7] << 8) | reply[8]);
+		specsLength = (reply[9] << 8) | reply[10];
+		if (offset + specsLength > size)
+			return probe_rejected;
+		for (specs = reply + offset; specs + 3 <= reply + offset + specsLength; specs += 3)
+		{
+			id = 0x02000000 | (specs[0] << 16) | (specs[1] << 8) | specs[2];
+			for (loop = 0; (ciphers[loop].name != 0) && ((ciphers[loop].id != id) || (accepted[loop] == true)); loop++)
+				;
+			if (ciphers[loop].name != 0)
+			{
+				accepted[loop] = true;
+				order[(*orderCount)++] = loop;
+			}
+		}
+	}
+
+	// SSLv3: handshake record, ServerHello 3.0, random, session id, suite
+	else
+	{
+		if ((size < 44) || (reply[0] != 0x16) || (reply[5] != 2) || (reply[9] != 0x03) || (reply[10] != 0x00))
+			return probe_rejected;
+		offset = 44 + reply[43];
+		if (offset + 2 > size)
+			return probe_rejected;
+		id = 0x03000000 | (reply[offset] << 8) | reply[offset + 1];
+		for (loop = 0; (ciphers[loop].name != 0) && ((ciphers[loop].id != id) || (accepted[loop] == true)); loop++)
+			;
+		if (ciphers[loop].name != 0)
+		{
+			accepted[loop] = true;
+			order[(*orderCount)++] = loop;
+		}
+	}
+
+	if (*orderCount == known)
+		return probe_rejected;
+	*failure = failure_none;
+	return probe_accepted;
+}
+
+
+// Detect SSLv2 or SSLv3 with raw records, without OpenSSL...
+//   One SSLv2 exchange finds all cipher specs the server shares. A SSLv3
+//   server picks one suite per ServerHello, the suites are found by
+//   elimination like the TLS 1.3 ones: one exchange per accepted suite,
+//   plus one. Only the hellos are exchanged, no handshake is completed.
+//   Returns false like testCipher().
+int testLegacy(struct sslCheckOptions *options, int sslVersion)
+{
+	// Variables...
+	const struct legacyCipher *ciphers = (sslVersion == ssl_v2) ? legacySSLv2 : legacySSLv3;
+	struct sslCipherResult *preferred = options->legacyPreferred + ((sslVersion == ssl_v2) ? 0 : 1);
+	struct sslCipherResult result;
+	struct traceSpan span;
+	unsigned char hello[BUFFERSIZE];
+	unsigned char *reply;
+	char accepted[legacy_ciphers_max];
+	int order[legacy_ciphers_max];
+	int orderCount = 0;
+	int reported = 0;
+	int exchanges = 0;
+	int cipherCount;
+	int probeStatus = probe_rejected;
+	int failure = failure_none;
+	int helloSize;
+	int replySize;
+	int attempt;
+	int loop;
+	long long connectStart;
+
+	reply = malloc(legacy_reply_max);
+	if (reply == NULL)
+		return false;
+	memset(accepted, 0, sizeof(accepted));
+	memset(&result, 0, sizeof(result));
+	result.sslVersion = sslVersion;
+	result.version = sslVersionName(sslVersion);
+	for (cipherCount = 0; ciphers[cipherCount].name != 0; cipherCount++)
+		;
+
+	do
+	{
+		helloSize = legacyHello(sslVersion, accepted, hello, sizeof(hello));
+		if (helloSize == 0)
+			break;
+
+		// One exchange of hellos...
+		metricsAdd(options, probesStarted, 1);
+		traceBegin(options, &span, phase_handshake);
+		connectStart = timeMicroseconds();
+		for (attempt = 0; ; attempt++)
+		{
+			replySize = legacyExchange(options, hello, helloSize, reply, legacy_reply_max);
+			if ((replySize >= 0) || (retryProbe(options, options->failure, attempt) == false))
+				break;
+		}
+		result.retries = attempt;
+		if (replySize < 0)
+		{
+			probeStatus = probe_failed;
+			failure = options->failure;
+			metricsAdd(options, probesFailed, 1);
+		}
+		else
+			probeStatus = legacyReply(sslVersion, reply, replySize, accepted, order, &orderCount, &failure);
+		if (replySize >= 0)
+			metricsProbe(options, (probeStatus == probe_accepted) ? 1 : 0);
+		traceEnd(options, &span, (probeStatus == probe_accepted) ? ciphers[order[orderCount - 1]].name : 0, result.version,
+			(probeStatus == probe_accepted) ? "accepted" : ((probeStatus == probe_rejected) ? "rejected" : "failed"));
+		result.handshakeTime = timeMicroseconds() - connectStart;
+
+		// Report what was accepted, in the server's order...
+		for (; reported < orderCount; reported++)
+		{
+			result.status = probe_accepted;
+			result.failure = failure_none;
+			result.cipher = ciphers[order[reported]].name;
+			result.bits = ciphers[order[reported]].bits;
+			result.cipherId = ciphers[order[reported]].id;
+			if (reported == 0)
+				memcpy(preferred, &result, sizeof(struct sslCipherResult));
+			if (options->callbacks.cipher != 0)
+				options->callbacks.cipher(options->userData, &result);
+		}
+	}
+	while ((probeStatus == probe_accepted) && (sslVersion == ssl_v3) && (++exchanges < cipherCount));
+	free(reply);
+
+	// The ciphers left got the answer to the last hello...
+	for (loop = 0; ciphers[loop].name != 0; loop++)
+	{
+		if (accepted[loop] == true)
+			continue;
+		result.status = (probeStatus == probe_failed) ? probe_failed : probe_rejected;
+		result.failure = failure;
+		result.cipher = ciphers[loop].name;
+		result.bits = ciphers[loop].bits;
+		result.cipherId = ciphers[loop].id;
+		if (options->callbacks.cipher != 0)
+			options->callbacks.cipher(options->userData, &result);
+	}
+
+	// A transient failure that outlasted the retries counts as no handshake...
+	return ((probeStatus != probe_failed) || (failure > failure_transient));
+}
+
+
+// Test for prefered ciphers
+int defaultCipher(struct sslCheckOptions *options, const SSL_METHOD *sslMethod)
+{
+	// Variables...
+	int cipherStatus;
+	int status = true;
+	int socketDescriptor = 0;
+	SSL_CTX *ctx;
+	SSL *ssl = NULL;
+	BIO *cipherConnectionBio;
+	const SSL_CIPHER *cipher;
+	int tempInt;
+	long long connectStart;
+	long long handshakeStart;
+	struct sslCipherResult result;
+	struct traceSpan span;
+
+	// Connect to host
+	metricsAdd(options, probesStarted, 1);
+	connectStart = timeMicroseconds();
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor != 0)
+	{
+
+		// Get Context Object...
+		ctx = getContext(options, sslMethod, false);
+		if (ctx != NULL)
+		{
+			// Create SSL object...
+			ssl = SSL_new(ctx);
+			if (ssl != NULL)
+			{
+				if (SSL_set_cipher_list(ssl, "ALL:COMPLEMENTOFALL") != 0)
+				{
+					// SSL implementation bugs/workaround
+					if (options->sslbugs)
+						SSL_set_options(ssl, SSL_OP_ALL);
+
+					// Connect socket and BIO
+					cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+
+					// Connect SSL and BIO
+					SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+
+					// set SNI Servername
+					if (options->sniEnable == true){
+						if(!SSL_set_tlsext_host_name(ssl,options->sniServername)){
+							status = false;
+							scanError(options, "    ERROR: Failed to set the SNI servername to %s (SSLv1-3 does not support SNI)", options->sniServername);
+						}
+					}
+
+					// add TLS Status reuqest (OCSP)
+					if (options->OCSPStatusRequest == true){
+						if(!SSL_set_tlsext_status_type(ssl, TLSEXT_STATUSTYPE_ocsp)){
+							status = false;
+							scanError(options, "    ERROR: Failed to set TLS Status request (OCSP stapling)");
+						}
+					}
+
+					// Connect SSL over socket
+					traceBegin(options, &span, phase_handshake);
+					handshakeStart = timeMicroseconds();
+					cipherStatus = SSL_connect(ssl);
+					metricsProbe(options, cipherStatus);
+					traceEnd(options, &span, (cipherStatus == 1) ? SSL_get_cipher_name(ssl) : 0, sslMethodName(sslMethod), (cipherStatus == 1) ? "preferred" : "failed");
+					if (cipherStatus == 1)
+					{
+						cipher = SSL_get_current_cipher(ssl);
+						memset(&result, 0, sizeof(result));
+						result.status = probe_accepted;
+						result.sslVersion = sslMethodVersion(sslMethod);
+						result.version = sslMethodName(sslMethod);
+						result.cipher = SSL_CIPHER_get_name(cipher);
+						result.bits = SSL_CIPHER_get_bits(cipher, &tempInt);
+						result.cipherId = SSL_CIPHER_get_id(cipher);
+						result.connectTime = handshakeStart - connectStart;
+						result.handshakeTime = timeMicroseconds() - handshakeStart;
+						if (options->callbacks.preferred != 0)
+							options->callbacks.preferred(options->userData, &result);
+
+						// Disconnect SSL over socket
+						SSL_shutdown(ssl);
+					}
+				}
+				else
+				{
+					status = false;
+					scanError(options, "    ERROR: Could set cipher.");
+				}
+
+				// Free SSL object
+				SSL_free(ssl);
+			}
+			else
+			{
+				status = false;
+				scanError(options, "    ERROR: Could create SSL object.");
+			}
+		}
+
+		// Error Creating Context Object
+		else
+		{
+			status = false;
+			scanError(options, "ERROR: Could not create CTX object.");
+		}
+
+		// Disconnect from host
+		tcpClose(options, socketDescriptor);
+	}
+
+	// Could not connect
+	else
+	{
+		status = false;
+		metricsAdd(options, probesFailed, 1);
+	}
+
+	return status;
+}
+
+
+// Get certificate...
+int getCertificate(struct sslCheckOptions *options)
+{
+	// Variables...
+	int cipherStatus = 0;
+	int status = true;
+	int socketDescriptor = 0;
+	SSL_CTX *ctx;
+	SSL *ssl = NULL;
+	BIO *cipherConnectionBio = NULL;
+	const SSL_METHOD *sslMethod = NULL;
+	int len = 0;
+	const unsigned char *raw_ocsp = NULL;
+	struct sslCertificateResult result;
+	struct traceSpan span;
+
+	// Connect to host
+	metricsAdd(options, probesStarted, 1);
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor != 0)
+	{
+
+		// Get Context Object (with trusted CAs)...
+		sslMethod = SSLv23_method();
+		ctx = getContext(options, sslMethod, true);
+		if (ctx != NULL)
+		{
+			// Create SSL object...
+			ssl = SSL_new(ctx);
+			if (ssl != NULL)
+			{
+				if (SSL_set_cipher_list(ssl, "ALL:COMPLEMENTOFALL") != 0)
+				{
+
+					// Connect socket and BIO
+					cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+
+					// Connect SSL and BIO
+					SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+
+					// set SNI Servername
+					if (options->sniEnable == true){
+						if(!SSL_set_tlsext_host_name(ssl,options->sniServername)){
+							status = false;
+							scanError(options, "    ERROR: Failed to set the SNI servername to %s (SSLv1-3 does not support SNI)", options->sniServername);
+						}
+					}
+
+					// add TLS Status reuqest (OCSP)
+					if (options->OCSPStatusRequest == true){
+						if(!SSL_set_tlsext_status_type(ssl, TLSEXT_STATUSTYPE_ocsp)){
+							status = false;
+							scanError(options, "    ERROR: Failed to set TLS Status request (OCSP stapling)");
+						}
+					}
+
+					// Connect SSL over socket
+					traceBegin(options, &span, phase_handshake);
+					cipherStatus = SSL_connect(ssl);
+					metricsProbe(options, cipherStatus);
+					traceEnd(options, &span, (cipherStatus == 1) ? SSL_get_cipher_name(ssl) : 0, (cipherStatus == 1) ? SSL_get_version(ssl) : 0, (cipherStatus == 1) ? "certificate" : "failed");
+					if (cipherStatus == 1)
+					{
+						traceBegin(options, &span, phase_certificate);
+
+						// Get Certificate...
+						memset(&result, 0, sizeof(result));
+						result.certificate = SSL_get_peer_certificate(ssl);
+						result.verifyResult = SSL_get_verify_result(ssl);
+
+						// Get the stapled OCSP response...
+						if (options->OCSPStatusRequest == true)
+						{
+							result.statusRequested = true;
+							len = SSL_get_tlsext_status_ocsp_resp(ssl, &raw_ocsp);
+							if (raw_ocsp != NULL)
+							{
+								result.ocspStapled = true;
+								result.ocspResponse = d2i_OCSP_RESPONSE(NULL, &raw_ocsp, len);
+							}
+						}
+
+						if (options->callbacks.certificate != 0)
+							options->callbacks.certificate(options->userData, &result);
+
+						// Free X509 Certificate and OCSP response...
+						if (result.certificate != NULL)
+							X509_free(result.certificate);
+						if (result.ocspResponse != NULL)
+							OCSP_RESPONSE_free(result.ocspResponse);
+						traceEnd(options, &span, SSL_get_cipher_name(ssl), SSL_get_version(ssl), "ok");
+
+						// Disconnect SSL over socket
+						SSL_shutdown(ssl);
+					}
+				}
+				else
+				{
+					status = false;
+					scanError(options, "    ERROR: Could set cipher.");
+				}
+
+				// Free SSL object
+				SSL_free(ssl);
+			}
+			else
+			{
+				status = false;
+				scanError(options, "    ERROR: Could create SSL object.");
+			}
+		}
+
+		// Error Creating Context Object
+		else
+		{
+			status = false;
+			scanError(options, "ERROR: Could not create CTX object.");
+		}
+
+		// Disconnect from host
+		tcpClose(options, socketDescriptor);
+	}
+
+	// Could not connect
+	else
+	{
+		status = false;
+		metricsAdd(options, probesFailed, 1);
+	}
+
+	return status;
+}
+
+
+// Can this OpenSSL offer any cipher of a cipher list?
+int cipherListSupported(SSL_CTX *ctx, const char *cipherList)
+{
+	// Variables...
+	SSL *ssl;
+	int status = false;
+
+	ssl = SSL_new(ctx);
+	if (ssl != NULL)
+	{
+		status = (SSL_set_cipher_list(ssl, cipherList) != 0);
+		SSL_free(ssl);
+	}
+	ERR_clear_error();
+	return status;
+}
+
+
+// Is a cipher in a ':' separated cipher list?
+int cipherListContains(const char *cipherList, const char *cipher)
+{
+	// Variables...
+	int length = strlen(cipher);
+
+	while (*cipherList != 0)
+	{
+		if ((strncmp(cipherList, cipher, length) == 0) && ((cipherList[length] == ':') || (cipherList[length] == 0)))
+			return true;
+		cipherList += strcspn(cipherList, ":");
+		if (*cipherList == ':')
+			cipherList++;
+	}
+	return false;
+}
+
+
+// Offer a whole cipher list in one handshake...
+//   Returns probe_accepted with the cipher the server picked, probe_rejected
+//   if the server answered with an alert or probe_failed if the host could
+//   not be reached or the handshake broke off otherwise.
+int policyProbe(struct sslCheckOptions *options, SSL_CTX *ctx, const char *cipherList, char *cipher, int cipherSize, const char **version)
+{
+	// Variables...
+	int cipherStatus;
+	int status = probe_failed;
+	int alert = 0;
+	int socketDescriptor;
+	SSL *ssl;
+	BIO *cipherConnectionBio;
+	struct traceSpan span;
+
+	// Connect to host
+	metricsAdd(options, probesStarted, 1);
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor == 0)
+	{
+		metricsAdd(options, probesFailed, 1);
+		return probe_failed;
+	}
+
+	// Create SSL object...
+	ssl = SSL_new(ctx);
+	if ((ssl != NULL) && (SSL_set_cipher_list(ssl, cipherList) != 0))
+	{
+#ifdef TLS1_3_VERSION
+		// The cipher list does not limit TLS 1.3 suites, a class never offers them
+		SSL_set_max_proto_version(ssl, TLS1_2_VERSION);
+#endif
+
+
+		// SSL implementation bugs/workaround
+		if (options->sslbugs)
+			SSL_set_options(ssl, SSL_OP_ALL);
+
+		// Connect socket, BIO and SSL
+		cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+		SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+
+		// Alerts tell a rejection from a failure
+		SSL_set_app_data(ssl, &alert);
+		SSL_set_info_callback(ssl, alertCallback);
+
+		// set SNI Servername (ignored by SSLv2 / SSLv3 only classes)
+		if (options->sniEnable == true)
+			SSL_set_tlsext_host_name(ssl, options->sniServername);
+
+		// Connect SSL over socket, only an alert rejects the class...
+		traceBegin(options, &span, phase_handshake);
+		cipherStatus = SSL_connect(ssl);
+		if (cipherStatus == 1)
+		{
+			snprintf(cipher, cipherSize, "%s", SSL_get_cipher_name(ssl));
+			*version = SSL_get_version(ssl);
+			status = probe_accepted;
+		}
+		else
+			status = (handshakeFailure(ssl, cipherStatus, alert) == failure_alert) ? probe_rejected : probe_failed;
+		metricsProbe(options, (status == probe_accepted) ? 1 : ((status == probe_rejected) ? 0 : -1));
+		traceEnd(options, &span, (status == probe_accepted) ? cipher : cipherList, (status == probe_accepted) ? *version : 0,
+			(status == probe_accepted) ? "accepted" : ((status == probe_rejected) ? "rejected" : "failed"));
+
+		// Disconnect SSL over socket
+		if (cipherStatus == 1)
+			SSL_shutdown(ssl);
+	}
+	else
+		scanError(options, "    ERROR: Could create SSL object.");
+	if (ssl != NULL)
+		SSL_free(ssl);
+	ERR_clear_error();
+
+	// Disconnect from host
+	tcpClose(options, socketDescriptor);
+	return status;
+}
+
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+// The group or signature algorithm the server picked (false if unknown)...
+//   Named the way exchange_groups and exchange_signatures name them.
+int exchangeChoice(SSL *ssl, int kind, char *name, int size, int *bits)
+{
+	// Variables...
+	EVP_PKEY *key;
+	int type = NID_undef;
+	int hash = NID_undef;
+	const char *curve = 0;
+	int loop;
+
+	*bits = 0;
+	if (kind == exchange_group)
+	{
+		if (SSL_get_server_tmp_key(ssl, &key) != 1)
+			return false;
+		*bits = EVP_PKEY_bits(key);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		// The negotiated group, else the group of the key (DH parameters
+		// that match a FFDHE group are named after it)...
+		type = SSL_get_negotiated_group(ssl);
+		if ((type == NID_undef) && (EVP_PKEY_get_group_name(key, name, size, NULL) == 1))
+			type = OBJ_txt2nid(name);
+		if (type == NID_undef)
+			type = EVP_PKEY_id(key);
+#else
+		type = EVP_PKEY_id(key);
+#ifdef OPENSSL_WITH_EC
+		if (type == EVP_PKEY_EC)
+			type = EC_GROUP_get_curve_name(EC_KEY_get0_group(EVP_PKEY_get0_EC_KEY(key)));
+#endif
+#endif
+		EVP_PKEY_free(key);
+#ifdef OPENSSL_WITH_EC
+		curve = EC_curve_nid2nist(type);
+#endif
+
+		// DH parameters of no known group can not be named
+		if ((type == EVP_PKEY_DH) || (type == NID_undef) || ((curve == 0) && (OBJ_nid2sn(type) == NULL)))
+			return false;
+		snprintf(name, size, "%s", (curve != 0) ? curve : OBJ_nid2sn(type));
+		return true;
+	}
+
+	if (SSL_get_peer_signature_type_nid(ssl, &type) != 1)
+		return false;
+	SSL_get_peer_signature_nid(ssl, &hash);
+	if (type == NID_rsaEncryption)
+		snprintf(name, size, "RSA+%s", OBJ_nid2sn(hash));
+	else if (type == NID_rsassaPss)
+		snprintf(name, size, "RSA-PSS+%s", OBJ_nid2sn(hash));
+	else if (type == NID_X9_62_id_ecPublicKey)
+		snprintf(name, size, "ECDSA+%s", OBJ_nid2sn(hash));
+	else
+	{
+		// ed25519, ed448
+		snprintf(name, size, "%s", OBJ_nid2sn(type));
+		for (loop = 0; name[loop] != 0; loop++)
+			name[loop] = tolower((unsigned char)name[loop]);
+	}
+	return true;
+}
+
+
+// Offer groups or signature algorithms (':' separated) in one handshake...
+//   Returns probe_accepted with the one the server picked, probe_rejected
+//   if the handshake did not complete or probe_failed if the host could not
+//   be reached.
+int exchangeProbe(struct sslCheckOptions *options, SSL_CTX *ctx, int sslVersion, const char *cipher, int kind, const char *offer, char *name, int size, int *bits)
+{
+	// Variables...
+	int cipherStatus;
+	int cipherSet;
+	int status = probe_failed;
+	int socketDescriptor;
+	SSL *ssl;
+	BIO *cipherConnectionBio;
+	struct traceSpan span;
+
+	// Connect to host
+	metricsAdd(options, probesStarted, 1);
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor == 0)
+	{
+		metricsAdd(options, probesFailed, 1);
+		return probe_failed;
+	}
+
+	// Create SSL object, with the cipher and what is offered...
+	ssl = SSL_new(ctx);
+	cipherSet = (ssl != NULL);
+	if ((cipherSet == true) && (sslVersion == tls_v1_3))
+		cipherSet = (SSL_set_min_proto_version(ssl, TLS1_3_VERSION) == 1) && (SSL_set_max_proto_version(ssl, TLS1_3_VERSION) == 1) && (SSL_set_ciphersuites(ssl, cipher) == 1);
+	else if (cipherSet == true)
+		cipherSet = (SSL_set_cipher_list(ssl, cipher) != 0);
+	if ((cipherSet == true) && (kind == exchange_group))
+		cipherSet = (SSL_set1_groups_list(ssl, offer) == 1);
+	else if (cipherSet == true)
+		cipherSet = (SSL_set1_sigalgs_list(ssl, offer) == 1);
+	if (cipherSet == true)
+	{
+		// Connect socket, BIO and SSL
+		cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+		SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+
+		// set SNI Servername
+		if (options->sniEnable == true)
+			SSL_set_tlsext_host_name(ssl, options->sniServername);
+
+		// Connect SSL over socket
+		traceBegin(options, &span, phase_handshake);
+		cipherStatus = SSL_connect(ssl);
+		metricsProbe(options, cipherStatus);
+		if ((cipherStatus == 1) && (exchangeChoice(ssl, kind, name, size, bits) == true))
+			status = probe_accepted;
+		else
+			status = probe_rejected;
+		traceEnd(options, &span, cipher, sslVersionName(sslVersion), (status == probe_accepted) ? name : "rejected");
+
+		// Disconnect SSL over socket
+		if (cipherStatus == 1)
+			SSL_shutdown(ssl);
+	}
+	else
+		scanError(options, "    ERROR: Could not offer %s.", offer);
+	if (ssl != NULL)
+		SSL_free(ssl);
+	ERR_clear_error();
+
+	// Disconnect from host
+	tcpClose(options, socketDescriptor);
+	return status;
+}
+
+
+// Enumerate the groups or signature algorithms a host accepts with a protocol...
+//   Like a policy class, everything is offered with the accepted cipher of
+//   the protocol and the server's pick is left out of the next offer,
+//   until it refuses the rest. This costs one handshake per accepted
+//   group or algorithm, plus one. Before TLS 1.3 the groups also limit the
+//   curve of an ECDSA certificate, so with ECDHE-ECDSA the list ends once
+//   the certificate's curve is no longer offered.
+int testExchange(struct sslCheckOptions *options, int index, int kind)
+{
+	// Variables...
+	struct sslExchangeResult result;
+	SSL_CTX *ctx;
+	SSL *ssl;
+	char known[BUFFERSIZE];
+	char offer[BUFFERSIZE];
+	char accepted[BUFFERSIZE];
+	char name[64];
+	const char *list = (kind == exchange_group) ? exchange_groups : exchange_signatures;
+	int probeStatus = probe_rejected;
+	int handshakes = 0;
+	int length;
+	int bits;
+
+	memset(&result, 0, sizeof(result));
+	result.kind = kind;
+	result.sslVersion = exchangeVersions[index];
+	result.version = sslVersionName(result.sslVersion);
+	result.cipher = options->exchangeCiphers[index];
+	result.name = name;
+
+	ctx = getContext(options, sslVersionMethod(result.sslVersion), false);
+	ssl = (ctx != NULL) ? SSL_new(ctx) : NULL;
+	if (ssl == NULL)
+	{
+		scanError(options, "ERROR: Could not create CTX object.");
+		return false;
+	}
+
+	// The ones this build of OpenSSL knows...
+	known[0] = 0;
+	while (*list != 0)
+	{
+		length = strcspn(list, ":");
+		snprintf(name, sizeof(name), "%.*s", length, list);
+		if (((kind == exchange_group) ? SSL_set1_groups_list(ssl, name) : SSL_set1_sigalgs_list(ssl, name)) == 1)
+			snprintf(known + strlen(known), sizeof(known) - strlen(known), "%s%s", (known[0] == 0) ? "" : ":", name);
+		list += length;
+		if (*list == ':')
+			list++;
+	}
+	SSL_free(ssl);
+	ERR_clear_error();
+
+	// Offer them until the server runs out...
+	accepted[0] = 0;
+	while (handshakes < exchange_handshakes_max)
+	{
+		offer[0] = 0;
+		for (list = known; *list != 0; list += (*list == ':') ? 1 : 0)
+		{
+			length = strcspn(list, ":");
+			snprintf(name, sizeof(name), "%.*s", length, list);
+			if (cipherListContains(accepted, name) == false)
+				snprintf(offer + strlen(offer), sizeof(offer) - strlen(offer), "%s%s", (offer[0] == 0) ? "" : ":", name);
+			list += length;
+		}
+		if (offer[0] == 0)
+			break;
+
+		probeStatus = exchangeProbe(options, ctx, result.sslVersion, result.cipher, kind, offer, name, sizeof(name), &bits);
+		handshakes++;
+		if ((probeStatus != probe_accepted) || (cipherListContains(offer, name) == false))
+			break;
+		snprintf(accepted + strlen(accepted), sizeof(accepted) - strlen(accepted), "%s%s", (accepted[0] == 0) ? "" : ":", name);
+
+		result.bits = bits;
+		if (options->callbacks.exchange != 0)
+			options->callbacks.exchange(options->userData, &result);
+	}
+
+	return (probeStatus != probe_failed);
+}
+
+
+// Enumerate the groups and signature algorithms of every protocol that
+// accepted a suitable cipher...
+int testExchanges(struct sslCheckOptions *options)
+{
+	// Variables...
+	int status = true;
+	int index;
+
+	for (index = 0; (index < exchange_versions) && (options->groups == true); index++)
+	{
+		if ((options->exchangeCiphers[index] != 0) && (testExchange(options, index, exchange_group) == false))
+			status = false;
+	}
+
+	// signature_algorithms exists from TLS 1.2 on
+	for (index = 0; (index < exchange_versions) && (options->sigalgs == true); index++)
+	{
+		if ((options->exchangeCiphers[index] != 0) && (exchangeVersions[index] >= tls_v1_2) && (testExchange(options, index, exchange_signature) == false))
+			status = false;
+	}
+	return status;
+}
+
+
+// A full or a resumed handshake of the resumption test...
+//   Offers session if it is set, noTicket leaves out the session ticket
+//   extension. The session of the connection is returned in next (to be
+//   freed). TLS 1.3 tickets come after the handshake, they are waited for a
+//   read timeout. Returns probe_accepted, probe_rejected or probe_failed.
+int resumptionProbe(struct sslCheckOptions *options, SSL_CTX *ctx, int sslVersion, SSL_SESSION *session, int noTicket, SSL_SESSION **next, int *resumed, long *handshakeTime)
+{
+	// Variables...
+	int cipherStatus;
+	int cipherSet;
+	int status = probe_failed;
+	int socketDescriptor;
+	int readStatus;
+	char byte;
+	SSL *ssl;
+	BIO *cipherConnectionBio;
+	struct pollfd pollDescriptor;
+	long long handshakeStart;
+	struct traceSpan span;
+
+	*next = 0;
+	*resumed = false;
+	*handshakeTime = 0;
+
+	// Connect to host
+	metricsAdd(options, probesStarted, 1);
+	socketDescriptor = tcpConnect(options);
+	if (socketDescriptor == 0)
+	{
+		metricsAdd(options, probesFailed, 1);
+		return probe_failed;
+	}
+
+	// Create SSL object, with the session to resume...
+	ssl = SSL_new(ctx);
+	cipherSet = (ssl != NULL);
+	if ((cipherSet == true) && (sslVersion == tls_v1_3))
+		cipherSet = (SSL_set_min_proto_version(ssl, TLS1_3_VERSION) == 1) && (SSL_set_max_proto_version(ssl, TLS1_3_VERSION) == 1);
+	if ((cipherSet == true) && (noTicket == true))
+		SSL_set_options(ssl, SSL_OP_NO_TICKET);
+	if ((cipherSet == true) && (session != 0))
+		cipherSet = (SSL_set_session(ssl, session) == 1);
+	if (cipherSet == true)
+	{
+		// Connect socket, BIO and SSL
+		cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
+		SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
+
+		// set SNI Servername
+		if (options->sniEnable == true)
+			SSL_set_tlsext_host_name(ssl, options->sniServername);
+
+		// Connect SSL over socket
+		traceBegin(options, &span, phase_handshake);
+		handshakeStart = timeMicroseconds();
+		cipherStatus = SSL_connect(ssl);
+		*handshakeTime = timeMicroseconds() - handshakeStart;
+		metricsProbe(options, cipherStatus);
+		status = (cipherStatus == 1) ? probe_accepted : ((cipherStatus == 0) ? probe_rejected : probe_failed);
+		if (cipherStatus == 1)
+			*resumed = (SSL_session_reused(ssl) == 1);
+		traceEnd(options, &span, 0, sslVersionName(sslVersion), (cipherStatus != 1) ? "failed" : ((*resumed == true) ? "resumed" : "full"));
+
+		if (cipherStatus == 1)
+		{
+			// Read the records after the handshake one at a time, until a ticket...
+			if ((sslVersion == tls_v1_3) && (noTicket == false) && (session == 0))
+			{
+				SSL_clear_mode(ssl, SSL_MODE_AUTO_RETRY);
+				pollDescriptor.fd = socketDescriptor;
+				pollDescriptor.events = POLLIN;
+				while ((SSL_SESSION_is_resumable(SSL_get0_session(ssl)) == 0) && (poll(&pollDescriptor, 1, readTimeout(options) / 1000) > 0))
+				{
+					readStatus = SSL_read(ssl, &byte, 1);
+					if ((readStatus > 0) || (SSL_get_error(ssl, readStatus) != SSL_ERROR_WANT_READ))
+						break;
+				}
+			}
+			*next = SSL_get1_session(ssl);
+
+			// Disconnect SSL over socket
+			SSL_shutdown(ssl);
+		}
+	}
+	else
+		scanError(options, "    ERROR: Could not offer a session to resume.");
+	if (ssl != NULL)
+		SSL_free(ssl);
+	ERR_clear_error();
+
+	// Disconnect from host
+	tcpClose(options, socketDescriptor);
+	return status;
+}
+
+
+// Median of handshake times (sorts them)...
+long medianTime(long *times, int count)
+{
+	// Variables...
+	long time;
+	int loop;
+	int position;
+
+	if (count == 0)
+		return 0;
+	for (loop = 1; loop < count; loop++)
+	{
+		time = times[loop];
+		for (position = loop; (position > 0) && (times[position - 1] > time); position--)
+			times[position] = times[position - 1];
+		times[position] = time;
+	}
+	return times[count / 2];
+}
+
+
+// Test session resumption with a protocol and method...
+//   resumption_samples pairs of a full handshake and one that offers the
+//   session of the full one, the pairs stop at the first handshake that is
+//   not resumed. Returns false if no full handshake could be made.
+int testResumption(struct sslCheckOptions *options, int sslVersion, int method)
+{
+	// Variables...
+	struct sslResumptionResult result;
+	SSL_SESSION *session;
+	SSL_SESSION *next;
+	SSL_CTX *ctx;
+	long fullTimes[resumption_samples];
+	long resumedTimes[resumption_samples];
+	long handshakeTime;
+	unsigned int idLength;
+	int fullCount = 0;
+	int resumedCount = 0;
+	int noTicket = (method == resumption_session_id);
+	int resumed;
+	int sample;
+
+	memset(&result, 0, sizeof(result));
+	result.method = method;
+	result.sslVersion = sslVersion;
+	result.version = sslVersionName(sslVersion);
+	result.ticketLifetime = -1;
+
+	ctx = getContext(options, sslVersionMethod(sslVersion), false);
+	if (ctx == NULL)
+	{
+		scanError(options, "ERROR: Could not create CTX object.");
+		return false;
+	}
+
+	for (sample = 0; sample < resumption_samples; sample++)
+	{
+		// Full handshake...
+		if (resumptionProbe(options, ctx, sslVersion, 0, noTicket, &session, &resumed, &handshakeTime) != probe_accepted)
+		{
+			if (session != 0)
+				SSL_SESSION_free(session);
+			break;
+		}
+		fullTimes[fullCount++] = handshakeTime;
+		if (session == 0)
+			break;
+		result.cipher = SSL_CIPHER_get_name(SSL_SESSION_get0_cipher(session));
+
+		// Nothing to offer without a session ID or a ticket...
+		SSL_SESSION_get_id(session, &idLength);
+		if (method == resumption_ticket)
+			result.ticketLifetime = (SSL_SESSION_has_ticket(session) == 1) ? (long)SSL_SESSION_get_ticket_lifetime_hint(session) : -1;
+		if (((method == resumption_ticket) && (result.ticketLifetime < 0)) || ((method == resumption_session_id) && (idLength == 0)))
+		{
+			SSL_SESSION_free(session);
+			break;
+		}
+
+		// ...and one that offers its session
+		resumptionProbe(options, ctx, sslVersion, session, noTicket, &next, &resumed, &handshakeTime);
+		SSL_SESSION_free(session);
+		if (next != 0)
+			SSL_SESSION_free(next);
+		if (resumed == false)
+			break;
+		resumedTimes[resumedCount++] = handshakeTime;
+	}
+
+	if (fullCount == 0)
+		return false;
+	result.resumed = (resumedCount > 0);
+	result.fullTime = medianTime(fullTimes, fullCount);
+	result.resumedTime = medianTime(resumedTimes, resumedCount);
+	if (options->callbacks.resumption != 0)
+		options->callbacks.resumption(options->userData, &result);
+	return true;
+}
+
+
+// Test session resumption with every protocol that accepted a cipher...
+//   Session IDs are replaced by tickets in TLS 1.3.
+int testResumptions(struct sslCheckOptions *options)
+{
+	// Variables...
+	int status = true;
+	int index;
+
+	for (index = 0; index < exchange_versions; index++)
+	{
+		if ((options->acceptedVersions & exchangeVersions[index]) == 0)
+			continue;
+		if ((exchangeVersions[index] != tls_v1_3) && (testResumption(options, exchangeVersions[index], resumption_session_id) == false))
+			status = false;
+		if (testResumption(options, exchangeVersions[index], resumption_ticket) == false)
+			status = false;
+	}
+	return status;
+}
+#endif
+
+
+// Audit the host against the cipher classes of the policy...
+//   Every class is offered as a whole in one handshake, a host that refuses
+//   it passes. Only an accepted class is expanded, by offering it again
+//   without the ciphers found so far until the server refuses. A class that
+//   could not be tested does not stop the audit, every class is reported.
+int testPolicy(struct sslCheckOptions *options)
+{
+	// Variables...
+	struct policyClass *policyClass;
+	struct sslPolicyResult result;
+	SSL_CTX *ctx;
+	char cipherList[BUFFERSIZE];
+	char accepted[BUFFERSIZE];
+	char cipher[128];
+	const char *version;
+	int probeStatus;
+	int status = true;
+
+	for (policyClass = options->policy; policyClass != 0; policyClass = policyClass->next)
+	{
+		memset(&result, 0, sizeof(result));
+		result.policyClass = policyClass->name;
+		result.ciphers = accepted;
+		accepted[0] = 0;
+
+		// Protocol or ciphers not in this build of OpenSSL...
+		ctx = getContext(options, sslVersionMethod(policyClass->sslVersion), false);
+		if ((ctx == NULL) || (cipherListSupported(ctx, policyClass->ciphers) == false))
+			result.status = policy_untested;
+
+		else
+		{
+			// Offer the class until the server runs out of ciphers in it...
+			snprintf(cipherList, sizeof(cipherList), "%s", policyClass->ciphers);
+			do
+			{
+				version = 0;
+				probeStatus = policyProbe(options, ctx, cipherList, cipher, sizeof(cipher), &version);
+				result.handshakes++;
+				if ((probeStatus != probe_accepted) || (cipherListContains(accepted, cipher) == true))
+					break;
+				if (result.version == 0)
+					result.version = version;
+				if (strlen(accepted) + strlen(cipher) + 2 < sizeof(accepted))
+					snprintf(accepted + strlen(accepted), sizeof(accepted) - strlen(accepted), "%s%s", (accepted[0] == 0) ? "" : ":", cipher);
+				if (strlen(cipherList) + strlen(cipher) + 3 >= sizeof(cipherList))
+					break;
+				snprintf(cipherList + strlen(cipherList), sizeof(cipherList) - strlen(cipherList), ":!%s", cipher);
+			}
+			while ((result.handshakes < policy_handshakes_max) && (cipherListSupported(ctx, cipherList) == true));
+
+			if (accepted[0] != 0)
+				result.status = policy_fail;
+			else if (probeStatus == probe_failed)
+			{
+				result.status = policy_error;
+				status = false;
+			}
+			else
+				result.status = policy_pass;
+		}
+
+		if (options->callbacks.policy != 0)
+			options->callbacks.policy(options->userData, &result);
+	}
+
+	return status;
+}
+
+
+// Test a single host and port for ciphers...
+int testHost(struct sslCheckOptions *options)
+{
+	// Variables...
+	struct sslCipher *sslCipherPointer;
+	struct addrinfo hints;
+	struct addrinfo *addressInfo;
+	SSL_CTX *ctx;
+	int status = true;
+	int failures = 0;
+	int index;
+	struct traceSpan hostSpan;
+
+	// Trace the whole host...
+	traceHost(options);
+	traceBegin(options, &hostSpan, phase_host);
+
+	// Capabilities and round trip time are learned again for every host...
+	options->smtpCapabilities = 0;
+	options->httpStatus[0] = 0;
+	options->httpCode = 0;
+	options->httpAttempts = 0;
+	memset(options->exchangeCiphers, 0, sizeof(options->exchangeCiphers));
+	options->acceptedVersions = 0;
+	options->smoothedRtt = 0;
+	options->rttVariance = 0;
+	options->retryBudget = retry_budget;
+	if (options->retrySeed == 0)
+		options->retrySeed = getpid() ^ timeMicroseconds();
+
+	// Resolve Host Name
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(options->host, NULL, &hints, &addressInfo) != 0)
+	{
+		scanError(options, "ERROR: Could not resolve hostname %s.", options->host);
+		traceEnd(options, &hostSpan, 0, 0, "unresolved");
+		arenaRelease(options);
+		return false;
+	}
+
+	// Configure Server Address and Port
+	memcpy(&options->serverAddress, addressInfo->ai_addr, sizeof(options->serverAddress));
+	options->serverAddress.sin_port = htons(options->port);
+	freeaddrinfo(addressInfo);
+
+	// Audit only the cipher classes of a policy...
+	if (options->callbacks.hostStart != 0)
+		options->callbacks.hostStart(options->userData, options->host, options->port);
+	if (options->policy != 0)
+		status = testPolicy(options);
+
+	// Test supported ciphers (a certificate only scan skips them)...
+	//   A probe that fails does not stop the scan, only failure_abandon
+	//   probes in a row without a handshake do.
+	sslCipherPointer = ((options->certOnly == true) || (options->policy != 0)) ? 0 : __atomic_load_n(&cipherCatalog, __ATOMIC_ACQUIRE);
+
+	// SSLv2 and SSLv3 without OpenSSL, with raw records...
+	memset(options->legacyPreferred, 0, sizeof(options->legacyPreferred));
+#ifdef LEGACY_SSLv2
+	if ((options->certOnly == false) && (options->policy == 0) && (options->sslVersion & ssl_v2) && (testLegacy(options, ssl_v2) == false))
+	{
+		status = false;
+		failures++;
+	}
+#endif
+#ifdef LEGACY_SSLv3
+	if ((options->certOnly == false) && (options->policy == 0) && (options->sslVersion & ssl_v3) && (testLegacy(options, ssl_v3) == false))
+	{
+		status = false;
+		failures++;
+	}
+#endif
+
+	while ((sslCipherPointer != 0) && (failures < failure_abandon))
+	{
+		// Protocol not requested for this host, TLS 1.3 goes last...
+		if (((sslCipherPointer->sslVersion & options->sslVersion) == 0) || (sslCipherPointer->sslVersion == tls_v1_3))
+		{
+			sslCipherPointer = sslCipherPointer->next;
+			continue;
+		}
+
+		// Get Context Object...
+		ctx = getContext(options, sslCipherPointer->sslMethod, false);
+		if ((ctx != NULL) && (testCipher(options, ctx, sslCipherPointer) == true))
+			failures = 0;
+		else
+		{
+			// Error Creating Context Object
+			if (ctx == NULL)
+				scanError(options, "ERROR: Could not create CTX object.");
+			status = false;
+			failures++;
+		}
+
+		sslCipherPointer = sslCipherPointer->next;
+	}
+
+	// TLS 1.3 suites, by elimination...
+	memset(&options->tls13Preferred, 0, sizeof(struct sslCipherResult));
+#ifdef TLS1_3_VERSION
+	if ((failures < failure_abandon) && (options->sslVersion & tls_v1_3) && (options->certOnly == false) && (options->policy == 0))
+	{
+		if (testTls13(options) == false)
+		{
+			status = false;
+			failures++;
+		}
+	}
+#endif
+
+	if ((failures < failure_abandon) && (options->certOnly == false) && (options->policy == 0))
+	{
+		// Test prefered ciphers...
+		if (options->callbacks.preferredStart != 0)
+			options->callbacks.preferredStart(options->userData);
+#ifndef DISABLE_SSLv2
+		if((options->sslVersion & ssl_v2) && (defaultCipher(options, SSLv2_client_method()) == false)) status = false;
+#endif
+#ifndef OPENSSL_NO_SSL3_METHOD
+		if((options->sslVersion & ssl_v3) && (defaultCipher(options, SSLv3_client_method()) == false)) status = false;
+#endif
+
+		// Raw SSLv2 and SSLv3 found theirs with the ciphers
+		for (index = 0; index < 2; index++)
+		{
+			if ((options->legacyPreferred[index].status == probe_accepted) && (options->callbacks.preferred != 0))
+				options->callbacks.preferred(options->userData, &options->legacyPreferred[index]);
+		}
+		if((options->sslVersion & tls_v1) && (defaultCipher(options, TLSv1_client_method()) == false)) status = false;
+		if((options->sslVersion & tls_v1_1) && (defaultCipher(options, TLSv1_1_client_method()) == false)) status = false;
+		if((options->sslVersion & tls_v1_2) && (defaultCipher(options, TLSv1_2_client_method()) == false)) status = false;
+
+		// TLS 1.3 was picked first by the elimination already
+		if ((options->tls13Preferred.status == probe_accepted) && (options->callbacks.preferred != 0))
+			options->callbacks.preferred(options->userData, &options->tls13Preferred);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+		// Key exchange groups and signature algorithms...
+		if (testExchanges(options) == false)
+			status = false;
+
+		// Session resumption...
+		if ((options->resumption == true) && (testResumptions(options) == false))
+			status = false;
+#endif
+	}
+
+	if ((failures < failure_abandon) && (options->policy == 0))
+	{
+		if (getCertificate(options) == false)
+			status = false;
+	}
+
+	// Every socket of the host has to be closed by now...
+	if (options->openSockets != 0)
+	{
+		scanError(options, "    ERROR: %d sockets to %s were left open.", options->openSockets, options->host);
+		options->openSockets = 0;
+		status = false;
+	}
+
+	if (options->callbacks.hostEnd != 0)
+		options->callbacks.hostEnd(options->userData, options->host, options->port, status);
+	traceEnd(options, &hostSpan, 0, 0, (status == true) ? "ok" : "failed");
+
+	// Everything the scan allocated goes in one go...
+	arenaRelease(options);
+
+	// Return status...
+	return status;
+}
+
+
+// Parse a scan option (shared by the command line and daemon jobs)...
+int parseScanOption(struct sslCheckOptions *options, const char *argument)
+{
+	// Show only supported
+	if ((strcmp("--no-failed", argument) == 0) || (strcmp("-n", argument) == 0))
+		options->noFailed = true;
+
+	// P Output
+	else if (strcmp("-p", argument) == 0)
+		options->pout = true;
+
+	// ESMTPS, SMTP with STARTTLS
+	else if ((strcmp("--esmtps", argument) == 0) || (strcmp("--starttls", argument) == 0))
+	{
+		options->esmtps = true;
+		options->port = 25;
+	}
+
+	// SMTP PIPELINING of EHLO and STARTTLS, if the server advertises it
+	else if (strcmp("--smtp-pipelining", argument) == 0)
+		options->smtpPipelining = true;
+
+	// FTPS / FTP over SSL
+	else if (strcmp("--ftps", argument) == 0)
+	{
+		options->ftps = true;
+		options->port = 21;
+	}
+
+	// FTPS / FTP over SSL check for Data Connection Sercurity: Private
+	else if (strcmp("--ftps-dcs", argument) == 0)
+	{
+		options->ftps = true;
+		options->ftps_dcs = true;
+		options->port = 21;
+	}
+
+	// POP3S / STLS for pop3
+	else if (strcmp("--pop3s", argument) == 0)
+	{
+		options->pop3s = true;
+		options->port = 110;
+	}
+
+	// IMAPS / SARTTLS for imap
+	else if (strcmp("--imaps", argument) == 0)
+	{
+		options->imaps = true;
+		options->port = 143;
+	}
+	
+	// SSL v2
+	else if (strcmp("--ssl2", argument) == 0)
+		options->sslVersion |= ssl_v2;
+
+	// SSL v3
+	else if (strcmp("--ssl3", argument) == 0)
+		options->sslVersion |= ssl_v3;
+
+	// TLS v1
+	else if (strcmp("--tls1", argument) == 0)
+		options->sslVersion |= tls_v1;
+
+	// TLS v1.1
+	else if (strcmp("--tls1_1", argument) == 0)
+		options->sslVersion |= tls_v1_1;
+
+	// TLS v1.2
+	else if (strcmp("--tls1_2", argument) == 0)
+		options->sslVersion |= tls_v1_2;
+
+#ifdef TLS1_3_VERSION
+	// TLS v1.3
+	else if (strcmp("--tls1_3", argument) == 0)
+		options->sslVersion |= tls_v1_3;
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	// Key exchange groups and signature algorithms
+	else if (strcmp("--groups", argument) == 0)
+		options->groups = true;
+	else if (strcmp("--sigalgs", argument) == 0)
+		options->sigalgs = true;
+
+	// Session resumption
+	else if (strcmp("--resumption", argument) == 0)
+		options->resumption = true;
+#endif
+
+	// all SSL & TLS protocols
+	else if ((strcmp("--all", argument) == 0) || (strcmp("-a", argument) == 0))
+		options->sslVersion |= ssl_tls_all;
+
+	// all SSL protocols
+	else if (strcmp("--ssl", argument) == 0)
+		options->sslVersion |= ssl_all;
+
+	// all TLS protocols
+	else if (strcmp("--tls", argument) == 0)
+		options->sslVersion |= tls_all;
+
+	// SSL Bugs...
+	else if (strcmp("--bugs", argument) == 0)
+		options->sslbugs = 1;
+
+	// SNI with a specific Servername
+	else if (strncmp("--sni=", argument, 6) == 0)
+	{
+		options->sniEnable = 1;
+		options->sniServername = internString(argument + 6);
+		if (options->sniServername == 0)
+		{
+			options->sniServername = "";
+			return false;
+		}
+	}
+	
+	// SNI, reuse the Hostname provided 
+	else if (strncmp("--sni", argument, 5) == 0)
+	{
+		options->sniEnable = 1;
+	}
+	
+	// TLS Certificate Status Request 
+	else if (((strcmp("--status-request", argument) == 0) ||  (strcmp("--ocsp-stapling", argument) == 0)) || (strcmp("-o", argument) == 0))
+		options->OCSPStatusRequest = 1;
+
+
+	// SSL HTTP Get...
+	else if (strcmp("--http", argument) == 0)
+		options->http = 1;
+
+	// Certificate only, one handshake per host
+	else if (strcmp("--cert-only", argument) == 0)
+		options->certOnly = true;
+
+	// Not a scan option
+	else
+		return false;
+
+	return true;
+}
+
+
+// Parse a trust / client certificate option (loaded into the contexts)...
+int parseIdentityOption(struct sslCheckOptions *options, const char *argument)
+{
+	// Trsuted CA file
+	if (strncmp("--cafile=", argument, 9) == 0)
+	{
+		if (internString(argument + 9) == 0)
+			return false;
+		options->cafile = internString(argument + 9);
+		freeTrustStore(options);
+	}
+
+	// Trusted CA directory (hashed, see c_rehash), replaces the default CA file
+	else if (strncmp("--capath=", argument, 9) == 0)
+	{
+		if (internString(argument + 9) == 0)
+			return false;
+		options->capath = internString(argument + 9);
+		if (strcmp(options->cafile, default_cafile) == 0)
+			options->cafile = "";
+		freeTrustStore(options);
+	}
+
+	// Client Certificates
+	else if (strncmp("--certs=", argument, 8) == 0)
+	{
+		free(options->clientCertsFile);
+		options->clientCertsFile = strdup(argument + 8);
+	}
+
+	// Private Key File
+	else if (strncmp("--pk=", argument, 5) == 0)
+	{
+		free(options->privateKeyFile);
+		options->privateKeyFile = strdup(argument + 5);
+	}
+
+	// Private Key Password
+	else if (strncmp("--pkpass=", argument, 9) == 0)
+	{
+		free(options->privateKeyPassword);
+		options->privateKeyPassword = strdup(argument + 9);
+	}
+
+	// Not an identity option
+	else
+		return false;
+
+	// Contexts loaded with the previous settings are stale...
+	freeContexts(options);
+	return true;
+}
+
+
+// Parse a connection option (source addresses and close)...
+int parseConnectionOption(struct sslCheckOptions *options, const char *argument)
+{
+	// Variables...
+	char addresses[BUFFERSIZE];
+	char *address;
+	char *next;
+
+	// Source addresses, comma separated (used in turn)
+	if (strncmp("--source=", argument, 9) == 0)
+	{
+		snprintf(addresses, sizeof(addresses), "%s", argument + 9);
+		for (address = strtok_r(addresses, ",", &next); address != 0; address = strtok_r(0, ",", &next))
+		{
+			if (options->sourceCount == source_max)
+			{
+				scanError(options, "ERROR: More than %d source addresses.", source_max);
+				return false;
+			}
+			if (inet_aton(address, &options->sourceAddresses[options->sourceCount]) == 0)
+			{
+				scanError(options, "ERROR: Invalid source address %s.", address);
+				return false;
+			}
+			options->sourceCount++;
+		}
+	}
+
+	// Reset connections instead of leaving them in TIME_WAIT
+	else if (strcmp("--abortive-close", argument) == 0)
+		options->abortiveClose = true;
+
+	// Not a connection option
+	else
+		return false;
+
+	return true;
+}
+
+
+// Free the arena, contexts, policy and identity of the options...
+//   The cipher catalog is shared, it stays for the life of the process.
+void freeOptions(struct sslCheckOptions *options)
+{
+	arenaRelease(options);
+	freeContexts(options);
+	freeTrustStore(options);
+	freePolicy(options);
+	free(options->clientCertsFile);
+	free(options->privateKeyFile);
+	free(options->privateKeyPassword);
+	options->clientCertsFile = 0;
+	options->privateKeyFile = 0;
+	options->privateKeyPassword = 0;
+}
+
+
+// Library: initialise OpenSSL...
+void sslScanInit(void)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	SSL_library_init();
+	SSLeay_add_all_algorithms();
+	ERR_load_crypto_strings();
+#else
+	OPENSSL_init_ssl(0, NULL);
+#endif
+}
+
+
+// Library: create a scan handle...
+struct sslCheckOptions *sslScanNew(void)
+{
+	// Variables...
+	struct sslCheckOptions *options;
+
+	options = malloc(sizeof(struct sslCheckOptions));
+	if (options == NULL)
+		return NULL;
+	memset(options, 0, sizeof(struct sslCheckOptions));
+	options->port = 443;
+	options->host = "";
+	options->cafile = default_cafile;
+	options->capath = "";
+	options->sniServername = "";
+	options->sslVersion = ssl_none;
+	return options;
+}
+
+
+// Library: set an option (command line syntax)...
+int sslScanSetOption(struct sslCheckOptions *options, const char *option)
+{
+	if (parseScanOption(options, option) == true)
+		return true;
+	if (strncmp("--policy=", option, 9) == 0)
+		return loadPolicy(options, option + 9);
+	if (parseConnectionOption(options, option) == true)
+		return true;
+	return parseIdentityOption(options, option);
+}
+
+
+// Library: share a trust store with other handles...
+void sslScanSetTrustStore(struct sslCheckOptions *options, X509_STORE *store)
+{
+	freeContexts(options);
+	freeTrustStore(options);
+	if (store != 0)
+	{
+		trustStoreReference(store);
+		options->trustStore = store;
+	}
+}
+
+
+// Library: set the result callbacks...
+void sslScanSetCallbacks(struct sslCheckOptions *options, const struct sslScanCallbacks *callbacks, void *userData)
+{
+	memcpy(&options->callbacks, callbacks, sizeof(struct sslScanCallbacks));
+	options->userData = userData;
+}
+
+
+// Library: write trace events...
+void sslScanSetTrace(struct sslCheckOptions *options, FILE *traceOutput)
+{
+	options->traceOutput = traceOutput;
+}
+
+
+// Library: count into metrics...
+void sslScanSetMetrics(struct sslCheckOptions *options, struct scanMetrics *metrics)
+{
+	options->metrics = metrics;
+}
+
+
+// Library: scan a host...
+int sslScanHost(struct sslCheckOptions *options, const char *host, int port)
+{
+	// Variables...
+	int sniFromHost;
+	int status;
+
+	options->host = arenaString(options, host);
+	if (port > 0)
+		options->port = port;
+
+	// Ciphers of newly requested protocols...
+	if (populateCiphers(options) == false)
+		return false;
+
+	// SNI without a specific Servername uses the host...
+	sniFromHost = (options->sniEnable == true) && (options->sniServername[0] == 0);
+	if (sniFromHost == true)
+		options->sniServername = options->host;
+
+	status = testHost(options);
+
+	if (sniFromHost == true)
+		options->sniServername = "";
+	return status;
+}
+
+
+// Library: check which endpoints answer a ClientHello with TLS...
+int sslScanSweep(struct sslCheckOptions *options, const struct sockaddr_in *addresses, int count, char *answered)
+{
+	// Variables...
+	unsigned char hello[sweep_hello];
+	struct sweepSlot *slots;
+	int helloSize;
+	int status = false;
+	int loop;
+
+	memset(answered, 0, count);
+	helloSize = clientHello(options, hello, sizeof(hello));
+	slots = calloc(count, sizeof(struct sweepSlot));
+	if ((helloSize == 0) || (slots == NULL))
+	{
+		scanError(options, "    ERROR: Could not create a ClientHello for the sweep.");
+		free(slots);
+		return false;
+	}
+	for (loop = 0; loop < count; loop++)
+		slots[loop].socketDescriptor = -1;
+
+	// io_uring if it can be used (not with source addresses), else epoll...
+#ifdef WITH_IO_URING
+	if ((options->sourceCount == 0) && (count <= sweep_width_max))
+		status = sweepRing(options, addresses, count, hello, helloSize, slots, answered);
+	if (status == false)
+	{
+		memset(answered, 0, count);
+		memset(slots, 0, count * sizeof(struct sweepSlot));
+		for (loop = 0; loop < count; loop++)
+			slots[loop].socketDescriptor = -1;
+#endif
+		status = sweepEpoll(options, addresses, count, hello, helloSize, slots, answered);
+#ifdef WITH_IO_URING
+	}
+#endif
+
+	free(slots);
+	return status;
+}
+
+
+// Library: free a scan handle...
+void sslScanFree(struct sslCheckOptions *options)
+{
+	freeOptions(options);
+	free(options);
+}
+
+
+#ifndef SSLSCAN_LIBRARY
+// Command line: show an error...
+void printError(void *userData, const char *message)
+{
+	printf("%s%s%s\n", COL_RED, message, RESET);
+}
+
+
+// Command line: certificates shown so far (direct mapped by fingerprint)...
+struct certificateRender
+{
+	unsigned char fingerprint[SHA256_DIGEST_LENGTH];
+	char host[512];
+	int port;
+	int used;
+};
+struct certificateRender *renderedCertificates = 0;
+
+
+// Command line: a sorted set of result items ("TLSv1.2 AES128-SHA")...
+struct resultSet
+{
+	char **items;
+	int count;
+	int size;
+};
+
+// Command line: the results of a host, from the baseline or from the scan...
+struct baselineHost
+{
+	char *key;                   // host:port or host:port:sni
+	struct resultSet ciphers;    // accepted ciphers
+	struct resultSet protocols;  // protocols with an accepted cipher
+	struct resultSet preferred;  // preferred cipher of each protocol
+	struct resultSet groups;     // key exchange groups of each protocol
+	struct resultSet signatures; // signature algorithms of each protocol
+	struct resultSet resumption; // resumption methods that resumed, of each protocol
+	char certificate[SHA256_DIGEST_LENGTH * 2 + 1];   // SHA-256 ("" if none)
+	int index;                   // of the seen flag
+	struct baselineHost *next;
+};
+
+// Command line: the baseline, hashed by key (--baseline)...
+//   The summary and the seen flags are shared with --parallel workers.
+struct baselineIndex
+{
+	struct baselineHost *buckets[baseline_buckets];
+	int hosts;
+	long *summary;
+	char *seen;
+};
+struct baselineIndex *baseline = 0;
+
+
+// Command line: a certificate, decoded once for all renderers...
+//   The fields are read when the model is built, the public key and
+//   the extension values (the costly part) are formatted the first time
+//   a renderer asks for them, at indent 0 so every renderer can indent
+//   them as it likes.
+struct certificateExtension
+{
+	X509_EXTENSION *extension;
+	char name[256];
+	int critical;
+	char *value;
+};
+
+struct certificateModel
+{
+	X509 *certificate;
+	unsigned char *der;
+	int derLength;
+	unsigned char fingerprint[SHA256_DIGEST_LENGTH];
+	long version;
+	char *serial;
+	int serialNegative;
+	char signatureAlgorithm[256];
+	char issuer[1024];
+	char subject[1024];
+	char notBefore[64];
+	char notAfter[64];
+	time_t expires;
+	char publicKeyAlgorithm[256];
+	EVP_PKEY *publicKey;
+	int publicKeyType;
+	int publicKeyBits;
+	char *publicKeyText;
+	int extensionCount;
+	struct certificateExtension *extensions;
+
+	// Shown for another host before (0 if not)...
+	struct certificateRender *sameAs;
+};
+
+
+// Command line: take the text written to a memory BIO (and free it)...
+//   The text is in the arena of the scan.
+char *bioText(struct sslCheckOptions *options, BIO *bio)
+{
+	// Variables...
+	char *data;
+	char *text;
+	long length;
+
+	length = BIO_get_mem_data(bio, &data);
+	text = arenaAlloc(options, length + 1);
+	if (text != NULL)
+	{
+		memcpy(text, data, length);
+		text[length] = 0;
+	}
+	BIO_free(bio);
+	return text;
+}
+
+
+// Command line: format a certificate time...
+void formatTime(struct sslCheckOptions *options, char *buffer, int size, ASN1_TIME *asn1Time)
+{
+	// Variables...
+	BIO *bio = BIO_new(BIO_s_mem());
+	char *text;
+
+	buffer[0] = 0;
+	if (bio == NULL)
+		return;
+	ASN1_TIME_print(bio, asn1Time);
+	text = bioText(options, bio);
+	if (text != NULL)
+		snprintf(buffer, size, "%s", text);
+}
+
+
+// Command line: names of the signature and public key algorithms...
+//   X509 is opaque from OpenSSL 1.1.0 on.
+void formatAlgorithms(struct certificateModel *model)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	OBJ_obj2txt(model->signatureAlgorithm, sizeof(model->signatureAlgorithm), model->certificate->cert_info->signature->algorithm, 0);
+	OBJ_obj2txt(model->publicKeyAlgorithm, sizeof(model->publicKeyAlgorithm), model->certificate->cert_info->key->algor->algorithm, 0);
+#else
+	// Variables...
+	const ASN1_OBJECT *signatureAlgorithm;
+	ASN1_OBJECT *publicKeyAlgorithm;
+
+	X509_ALGOR_get0(&signatureAlgorithm, NULL, NULL, X509_get0_tbs_sigalg(model->certificate));
+	OBJ_obj2txt(model->signatureAlgorithm, sizeof(model->signatureAlgorithm), signatureAlgorithm, 0);
+	X509_PUBKEY_get0_param(&publicKeyAlgorithm, NULL, NULL, NULL, X509_get_X509_PUBKEY(model->certificate));
+	OBJ_obj2txt(model->publicKeyAlgorithm, sizeof(model->publicKeyAlgorithm), publicKeyAlgorithm, 0);
+#endif
+}
+
+
+// Command line: decode a certificate into the model...
+void buildCertificateModel(struct sslCheckOptions *options, struct certificateModel *model, X509 *x509Cert)
+{
+	// Variables...
+	ASN1_INTEGER *asn1Serial;
+	const unsigned char *serialData;
+	unsigned int fingerprintLength;
+	int serialLength;
+	int days;
+	int seconds;
+	int loop;
+
+	memset(model, 0, sizeof(struct certificateModel));
+	model->certificate = x509Cert;
+	model->derLength = i2d_X509(x509Cert, &model->der);
+	if (!X509_digest(x509Cert, EVP_sha256(), model->fingerprint, &fingerprintLength))
+		memset(model->fingerprint, 0, sizeof(model->fingerprint));
+	model->version = X509_get_version(x509Cert);
+
+	// Serial number, "xx:xx:..."...
+	asn1Serial = X509_get_serialNumber(x509Cert);
+	if (asn1Serial != NULL)
+	{
+		serialLength = ASN1_STRING_length(asn1Serial);
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+		serialData = ASN1_STRING_data(asn1Serial);
+#else
+		serialData = ASN1_STRING_get0_data(asn1Serial);
+#endif
+		model->serialNegative = (ASN1_STRING_type(asn1Serial) == V_ASN1_NEG_INTEGER);
+		model->serial = arenaAlloc(options, serialLength * 3 + 1);
+		if (model->serial != NULL)
+		{
+			model->serial[0] = 0;
+			for (loop = 0; loop < serialLength; loop++)
+				sprintf(model->serial + loop * 3, "%02x%s", serialData[loop], (loop + 1 == serialLength) ? "" : ":");
+		}
+	}
+
+	formatAlgorithms(model);
+	X509_NAME_oneline(X509_get_issuer_name(x509Cert), model->issuer, sizeof(model->issuer) - 1);
+	X509_NAME_oneline(X509_get_subject_name(x509Cert), model->subject, sizeof(model->subject) - 1);
+	formatTime(options, model->notBefore, sizeof(model->notBefore), X509_get_notBefore(x509Cert));
+	formatTime(options, model->notAfter, sizeof(model->notAfter), X509_get_notAfter(x509Cert));
+	if (ASN1_TIME_diff(&days, &seconds, NULL, X509_get_notAfter(x509Cert)))
+		model->expires = time(NULL) + (time_t)days * 86400 + seconds;
+
+	// Public key...
+	model->publicKey = X509_get_pubkey(x509Cert);
+	if (model->publicKey != NULL)
+	{
+		model->publicKeyType = EVP_PKEY_base_id(model->publicKey);
+		model->publicKeyBits = EVP_PKEY_bits(model->publicKey);
+	}
+
+	// Extensions...
+	model->extensionCount = X509_get_ext_count(x509Cert);
+	if (model->extensionCount > 0)
+	{
+		model->extensions = arenaAlloc(options, model->extensionCount * sizeof(struct certificateExtension));
+		if (model->extensions == NULL)
+			model->extensionCount = 0;
+		else
+			memset(model->extensions, 0, model->extensionCount * sizeof(struct certificateExtension));
+	}
+	for (loop = 0; loop < model->extensionCount; loop++)
+	{
+		model->extensions[loop].extension = X509_get_ext(x509Cert, loop);
+		OBJ_obj2txt(model->extensions[loop].name, sizeof(model->extensions[loop].name), X509_EXTENSION_get_object(model->extensions[loop].extension), 0);
+		model->extensions[loop].critical = X509_EXTENSION_get_critical(model->extensions[loop].extension);
+	}
+}
+
+
+// Command line: the public key as text (formatted on first use)...
+const char *certificatePublicKey(struct sslCheckOptions *options, struct certificateModel *model)
+{
+	// Variables...
+	BIO *bio;
+	RSA *rsa;
+	DSA *dsa;
+#ifdef OPENSSL_WITH_EC
+	EC_KEY *ecKey;
+#endif
+
+	if (model->publicKeyText != 0)
+		return model->publicKeyText;
+
+	bio = BIO_new(BIO_s_mem());
+	if (bio == NULL)
+		return "";
+	switch (model->publicKeyType)
+	{
+		case EVP_PKEY_RSA:
+			rsa = EVP_PKEY_get1_RSA(model->publicKey);
+			RSA_print(bio, rsa, 0);
+			RSA_free(rsa);
+			break;
+		case EVP_PKEY_DSA:
+			dsa = EVP_PKEY_get1_DSA(model->publicKey);
+			DSA_print(bio, dsa, 0);
+			DSA_free(dsa);
+			break;
+#ifdef OPENSSL_WITH_EC
+		case EVP_PKEY_EC:
+			ecKey = EVP_PKEY_get1_EC_KEY(model->publicKey);
+			EC_KEY_print(bio, ecKey, 0);
+			EC_KEY_free(ecKey);
+			break;
+#endif
+	}
+	model->publicKeyText = bioText(options, bio);
+	return (model->publicKeyText != 0) ? model->publicKeyText : "";
+}
+
+
+// Command line: the value of an extension as text (formatted on first use)...
+const char *certificateExtensionValue(struct sslCheckOptions *options, struct certificateModel *model, int index)
+{
+	// Variables...
+	struct certificateExtension *extension = model->extensions + index;
+	BIO *bio;
+
+	if (extension->value != 0)
+		return extension->value;
+
+	bio = BIO_new(BIO_s_mem());
+	if (bio == NULL)
+		return "";
+	if (!X509V3_EXT_print(bio, extension->extension, X509_FLAG_COMPAT, 0))
+		ASN1_STRING_print(bio, (ASN1_STRING *)X509_EXTENSION_get_data(extension->extension));
+	extension->value = bioText(options, bio);
+	return (extension->value != 0) ? extension->value : "";
+}
+
+
+// Command line: free a certificate model (the text is in the arena)...
+void freeCertificateModel(struct certificateModel *model)
+{
+	OPENSSL_free(model->der);
+	if (model->publicKey != NULL)
+		EVP_PKEY_free(model->publicKey);
+}
+
+
+// Command line: print text with every line indented...
+void printIndented(FILE *output, const char *text, int indent)
+{
+	// Variables...
+	const char *newLine;
+
+	while (*text != 0)
+	{
+		newLine = strchr(text, '\n');
+		if (newLine == NULL)
+			newLine = text + strlen(text) - 1;
+		fprintf(output, "%*s%.*s", indent, "", (int)(newLine + 1 - text), text);
+		text = newLine + 1;
+	}
+}
+
+
+// Command line: has this certificate been shown for another host?
+//   Returns the host it was shown for, or remembers it for this host.
+struct certificateRender *certificateShownFor(struct sslCheckOptions *options, struct certificateModel *model)
+{
+	// Variables...
+	struct certificateRender *render;
+
+	if (renderedCertificates == 0)
+	{
+		renderedCertificates = calloc(certificate_cache_size, sizeof(struct certificateRender));
+		if (renderedCertificates == 0)
+			return NULL;
+	}
+	render = renderedCertificates + (model->fingerprint[0] | (model->fingerprint[1] << 8)) % certificate_cache_size;
+
+	if ((render->used == true) && (memcmp(render->fingerprint, model->fingerprint, SHA256_DIGEST_LENGTH) == 0)
+		&& ((strcmp(render->host, options->host) != 0) || (render->port != options->port)))
+		return render;
+
+	memcpy(render->fingerprint, model->fingerprint, SHA256_DIGEST_LENGTH);
+	memset(render->host, 0, sizeof(render->host));
+	strncpy(render->host, options->host, sizeof(render->host) - 1);
+	render->port = options->port;
+	render->used = true;
+	return NULL;
+}
+
+
+// Command line: an output format, fed by the scan callbacks (any
+// function may be 0)...
+struct outputRenderer
+{
+	int (*enabled)(struct sslCheckOptions *options);
+	void (*hostStart)(struct sslCheckOptions *options, const char *host, int port);
+	void (*cipher)(struct sslCheckOptions *options, const struct sslCipherResult *result);
+	void (*preferredStart)(struct sslCheckOptions *options);
+	void (*preferred)(struct sslCheckOptions *options, const struct sslCipherResult *result);
+	void (*certificate)(struct sslCheckOptions *options, struct certificateModel *model, const struct sslCertificateResult *result);
+	void (*hostEnd)(struct sslCheckOptions *options, const char *host, int port, int status);
+	void (*policy)(struct sslCheckOptions *options, const struct sslPolicyResult *result);
+	void (*exchange)(struct sslCheckOptions *options, const struct sslExchangeResult *result);
+	void (*resumption)(struct sslCheckOptions *options, const struct sslResumptionResult *result);
+};
+
+
+// Text: enabled unless --quiet, --count, --cert-only or --baseline...
+int textEnabled(struct sslCheckOptions *options)
+{
+	return ((options->quiet == false) && (options->count == false) && (options->certOnly == false) && (baseline == 0));
+}
+
+
+// Text: kind of the last key exchange parameter shown for the current host...
+int textExchangeKind = -1;
+
+// Text: the session resumption section was started for the current host...
+int textResumptionShown = false;
+
+// Names of the session resumption methods...
+const char *resumptionMethods[] = { "session ID", "ticket" };
+
+
+// Text: start of a host...
+void textHostStart(struct sslCheckOptions *options, const char *host, int port)
+{
+	textExchangeKind = -1;
+	textResumptionShown = false;
+	printf("\n%sTesting SSL server %s on port %d%s\n\n", COL_GREEN, host, port, RESET);
+	if (options->policy != 0)
+	{
+		printf("  %sCipher Policy:%s\n", COL_BLUE, RESET);
+		if (options->pout == true)
+			printf("|| Result || Class || Version || Ciphers ||\n");
+		return;
+	}
+	printf("  %sSupported Server Cipher(s):%s\n", COL_BLUE, RESET);
+	if ((options->http == true) && (options->pout == true))
+		printf("|| Status || HTTP Code || Version || Bits || Cipher ||\n");
+	else if (options->pout == true)
+		printf("|| Status || Version || Bits || Cipher ||\n");
+}
+
+
+// Text: the bits and cipher columns...
+void textCipherName(struct sslCheckOptions *options, const struct sslCipherResult *result, const char *bitsSuffix)
+{
+	// Variables...
+	int padding = (result->bits < 10) ? 2 : ((result->bits < 100) ? 1 : 0);
+
+	if (options->pout == true)
+		printf("%d%s || %*s%s ||\n", result->bits, bitsSuffix, padding, "", result->cipher);
+	else
+		printf("%d bits  %*s%s\n", result->bits, padding, "", result->cipher);
+}
+
+
+// Text: a cipher probe...
+void textCipher(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	if ((options->noFailed == true) && (result->status != probe_accepted))
+		return;
+
+	if (result->status == probe_accepted)
+	{
+		if (options->pout == true)
+			printf("|| Accepted || ");
+		else
+			printf("    Accepted  ");
+		if (options->http == true)
+		{
+			// Output HTTP code...
+			if (result->httpStatus != 0)
+			{
+				if (options->pout == true)
+					printf("%s || ", result->httpStatus);
+				else
+					printf("%-17s", result->httpStatus);
+			}
+			else
+			{
+				if (options->pout == true)
+					printf("|| || ");
+				else
+					printf("                 ");
+			}
+		}
+		// FTPS: Data Connection Security...
+		else if (result->dataChannel != 0)
+		{
+			if (atoi(result->dataChannel) == 200)
+				printf("Data-Channel-Encryption-Support: OK (%s)  ", result->dataChannel);
+			else
+				printf("Data-Channel-Encryption-Support: NA (%s)  ", result->dataChannel);
+		}
+	}
+	else if (result->status == probe_rejected)
+	{
+		if (options->http == true)
+		{
+			if (options->pout == true)
+				printf("|| Rejected || N/A || ");
+			else
+				printf("    Rejected  N/A              ");
+		}
+		else
+		{
+			if (options->pout == true)
+				printf("|| Rejected || ");
+			else
+				printf("    Rejected  ");
+		}
+	}
+	else
+	{
+		if (options->http == true)
+		{
+			if (options->pout == true)
+				printf("|| Failed || N/A || ");
+			else
+				printf("    Failed    N/A              ");
+		}
+		else
+		{
+			if (options->pout == true)
+				printf("|| Failed || ");
+			else
+				printf("    Failed    ");
+		}
+	}
+
+	// Version, bits and cipher...
+	if (options->pout == true)
+		printf("%s || ", result->version);
+	else
+		printf("%s  ", result->version);
+	textCipherName(options, result, "");
+}
+
+
+// Text: start of the preferred ciphers...
+void textPreferredStart(struct sslCheckOptions *options)
+{
+	printf("\n  %sPrefered Server Cipher(s):%s\n", COL_BLUE, RESET);
+	if (options->pout == true)
+		printf("|| Version || Bits || Cipher ||\n");
+}
+
+
+// Text: a preferred cipher...
+void textPreferred(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	if (options->pout == true)
+		printf("|| %s || ", result->version);
+	else
+		printf("    %s  ", result->version);
+	textCipherName(options, result, " bits");
+}
+
+
+// Text: a key exchange group or signature algorithm...
+void textExchange(struct sslCheckOptions *options, const struct sslExchangeResult *result)
+{
+	if (result->kind != textExchangeKind)
+	{
+		textExchangeKind = result->kind;
+		printf("\n  %s%s:%s\n", COL_BLUE, (result->kind == exchange_group) ? "Server Key Exchange Group(s)" : "Server Signature Algorithm(s)", RESET);
+		if ((options->pout == true) && (result->kind == exchange_group))
+			printf("|| Version || Bits || Group ||\n");
+		else if (options->pout == true)
+			printf("|| Version || Signature Algorithm ||\n");
+	}
+
+	if ((options->pout == true) && (result->kind == exchange_group))
+		printf("|| %s || %d || %s ||\n", result->version, result->bits, result->name);
+	else if (options->pout == true)
+		printf("|| %s || %s ||\n", result->version, result->name);
+	else if (result->kind == exchange_group)
+		printf("    %-7s  %4d bits  %s\n", result->version, result->bits, result->name);
+	else
+		printf("    %-7s  %s\n", result->version, result->name);
+}
+
+
+// Text: session resumption with a protocol and method...
+void textResumption(struct sslCheckOptions *options, const struct sslResumptionResult *result)
+{
+	// Variables...
+	double speedup = (result->resumedTime > 0) ? (double)result->fullTime / result->resumedTime : 0.0;
+
+	if (textResumptionShown == false)
+	{
+		textResumptionShown = true;
+		printf("\n  %sSession Resumption:%s\n", COL_BLUE, RESET);
+		if (options->pout == true)
+			printf("|| Version || Method || Resumed || Full ms || Resumed ms || Speedup || Ticket Lifetime ||\n");
+	}
+
+	if (options->pout == true)
+	{
+		printf("|| %s || %s || %s || %.2f || ", result->version, resumptionMethods[result->method], (result->resumed == true) ? "Yes" : "No", result->fullTime / 1000.0);
+		if (result->resumed == true)
+			printf("%.2f || %.1fx || ", result->resumedTime / 1000.0, speedup);
+		else
+			printf("|| || ");
+		if (result->ticketLifetime >= 0)
+			printf("%ld s ||\n", result->ticketLifetime);
+		else
+			printf("||\n");
+		return;
+	}
+
+	printf("    %-7s  %-10s  ", result->version, resumptionMethods[result->method]);
+	if (result->resumed == true)
+		printf("%sresumed%s      full %.2f ms  resumed %.2f ms  %.1fx faster", COL_GREEN, RESET, result->fullTime / 1000.0, result->resumedTime / 1000.0, speedup);
+	else
+		printf("%snot resumed%s  full %.2f ms", COL_RED, RESET, result->fullTime / 1000.0);
+	if (result->ticketLifetime >= 0)
+		printf("  lifetime %ld s", result->ticketLifetime);
+	printf("\n");
+}
+
+
+// Text: a cipher class of the policy...
+void textPolicy(struct sslCheckOptions *options, const struct sslPolicyResult *result)
+{
+	// Variables...
+	const char *colour = (result->status == policy_pass) ? COL_GREEN : ((result->status == policy_untested) ? RESET : COL_RED);
+	const char *status[] = { "Pass", "Fail", "Untested", "Error" };
+
+	if (options->pout == true)
+		printf("|| %s%s%s || %s || %s || %s ||\n", colour, status[result->status], RESET, result->policyClass, (result->version != 0) ? result->version : "", result->ciphers);
+	else if (result->status == policy_fail)
+		printf("    %s%-8s%s  %-12s  %s  %s\n", colour, status[result->status], RESET, result->policyClass, result->version, result->ciphers);
+	else if (result->status == policy_untested)
+		printf("    %s%-8s%s  %-12s  (not supported by OpenSSL)\n", colour, status[result->status], RESET, result->policyClass);
+	else
+		printf("    %s%-8s%s  %s\n", colour, status[result->status], RESET, result->policyClass);
+}
+
+
+// Text: the certificate...
+void textCertificate(struct sslCheckOptions *options, struct certificateModel *model, const struct sslCertificateResult *result)
+{
+	// Variables...
+	BIO *stdoutBIO = NULL;
+	int loop;
+
+	printf("\n  %sSSL Certificate:%s\n", COL_BLUE, RESET);
+
+	// Shown before, refer to it...
+	if (model->sameAs != 0)
+	{
+		printf("    Same as the certificate of %s on port %d\n", model->sameAs->host, model->sameAs->port);
+		printf("    SHA-256 Fingerprint: ");
+		for (loop = 0; loop < SHA256_DIGEST_LENGTH; loop++)
+			printf("%02x%c", model->fingerprint[loop], (loop + 1 == SHA256_DIGEST_LENGTH) ? '\n' : ':');
+	}
+	else if (model->certificate != NULL)
+	{
+		printf("    Version: %lu (0x%lx)\n", model->version + 1, model->version);
+		if (model->serial == 0)
+			printf("%s    ERROR: X509_get_serialNumber() failed to get serial from certificate.%s\n", COL_RED, RESET);
+		else
+			printf("    Serial Number: %s%s\n", model->serialNegative ? "(Negative)" : "", model->serial);
+		printf("    Signature Algorithm: %s\n", model->signatureAlgorithm);
+		printf("    Issuer: %s\n", model->issuer);
+		printf("    Not valid before: %s\n", model->notBefore);
+		printf("    Not valid after: %s\n", model->notAfter);
+		printf("    Subject: %s\n", model->subject);
+		printf("    Public Key Algorithm: %s\n", model->publicKeyAlgorithm);
+
+		// Public Key...
+		if (model->publicKey == NULL)
+			printf("    Public Key: Could not load\n");
+		else if (model->publicKeyType == EVP_PKEY_RSA)
+			printf("    RSA Public Key: (%d bit)\n", model->publicKeyBits);
+		else if (model->publicKeyType == EVP_PKEY_DSA)
+			printf("    DSA Public Key:\n");
+#ifdef OPENSSL_WITH_EC
+		else if (model->publicKeyType == EVP_PKEY_EC)
+			printf("    EC Public Key:\n");
+#endif
+		else
+			printf("    Public Key: Unknown\n");
+		if (model->publicKey != NULL)
+			printIndented(stdout, certificatePublicKey(options, model), 6);
+
+		// X509 v3...
+		if (model->extensionCount > 0)
+		{
+			printf("    X509v3 Extensions:\n");
+			for (loop = 0; loop < model->extensionCount; loop++)
+			{
+				printf("      %s: %s\n", model->extensions[loop].name, model->extensions[loop].critical ? "critical" : "");
+				printIndented(stdout, certificateExtensionValue(options, model, loop), 8);
+				printf("\n");
+			}
+		}
+	}
+
+	// Verify Certificate...
+	if (model->certificate != NULL)
+	{
+		printf("  Verify Certificate:\n");
+		if (result->verifyResult == X509_V_OK)
+			printf("    Certificate passed verification\n");
+		else
+			printf("    %s\n", X509_verify_cert_error_string(result->verifyResult));
+	}
+
+	// Show OCSP Ticket
+	if (result->statusRequested == true){
+		printf("\n  %sCertificate Status Request (OCSP Stapling):%s\n", COL_BLUE, RESET);
+		if(result->ocspStapled == false){
+			printf("Certificate Status Request sent but no OCSP ticket stapled in response.\n");
+		}
+		else if(result->ocspResponse == NULL){
+			printf("failed to parse OCSP response :( \n");
+		}
+		else{
+			// print/dump the response to the screen
+			stdoutBIO = BIO_new(BIO_s_file());
+			BIO_set_fp(stdoutBIO, stdout, BIO_NOCLOSE);
+			OCSP_RESPONSE_print(stdoutBIO,result->ocspResponse,0);
+			BIO_free(stdoutBIO);
+		}
+	}
+}
+
+
+// XML: enabled with --xml...
+int xmlEnabled(struct sslCheckOptions *options)
+{
+	return (options->xmlOutput != 0);
+}
+
+
+// XML: start of a host...
+void xmlHostStart(struct sslCheckOptions *options, const char *host, int port)
+{
+	if ((options->sniEnable == true) && (options->sniServername[0] != 0))
+		fprintf(options->xmlOutput, " <ssltest host=\"%s\" port=\"%d\" sni=\"%s\">\n", host, port, options->sniServername);
+	else
+		fprintf(options->xmlOutput, " <ssltest host=\"%s\" port=\"%d\">\n", host, port);
+}
+
+
+// XML: names of the failure classes...
+const char *failureNames[] = { "none", "timeout", "reset", "local", "alert", "closed", "protocol", "network" };
+
+
+// XML: a cipher probe...
+void xmlCipher(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	if ((options->noFailed == true) && (result->status != probe_accepted))
+		return;
+
+	fprintf(options->xmlOutput, "  <cipher status=\"");
+	if (result->status == probe_accepted)
+	{
+		fprintf(options->xmlOutput, "accepted\"");
+		if (options->http == true)
+		{
+			if (result->httpStatus != 0)
+				fprintf(options->xmlOutput, " http=\"%s\"", result->httpStatus);
+		}
+		else if (result->dataChannel != 0)
+			fprintf(options->xmlOutput, " data-connection-security-private=\"%s\"", result->dataChannel);
+	}
+	else if (result->status == probe_rejected)
+		fprintf(options->xmlOutput, "rejected\"");
+	else
+		fprintf(options->xmlOutput, "failed\" failure=\"%s\"", failureNames[result->failure]);
+	if (result->alert != 0)
+		fprintf(options->xmlOutput, " alert=\"%s\"", result->alert);
+	fprintf(options->xmlOutput, " sslversion=\"%s\" bits=\"%d\" cipher=\"%s\" />\n", result->version, result->bits, result->cipher);
+}
+
+
+// XML: a preferred cipher...
+void xmlPreferred(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	fprintf(options->xmlOutput, "  <defaultcipher sslversion=\"%s\" bits=\"%d\" cipher=\"%s\" />\n", result->version, result->bits, result->cipher);
+}
+
+
+// XML: a key exchange group or signature algorithm...
+void xmlExchange(struct sslCheckOptions *options, const struct sslExchangeResult *result)
+{
+	if (result->kind == exchange_group)
+		fprintf(options->xmlOutput, "  <group sslversion=\"%s\" bits=\"%d\" name=\"%s\" />\n", result->version, result->bits, result->name);
+	else
+		fprintf(options->xmlOutput, "  <signature sslversion=\"%s\" name=\"%s\" />\n", result->version, result->name);
+}
+
+
+// XML: session resumption with a protocol and method...
+void xmlResumption(struct sslCheckOptions *options, const struct sslResumptionResult *result)
+{
+	fprintf(options->xmlOutput, "  <resumption sslversion=\"%s\" method=\"%s\" resumed=\"%s\"", result->version, (result->method == resumption_ticket) ? "ticket" : "sessionid",
+		(result->resumed == true) ? "true" : "false");
+	if (result->cipher != 0)
+		fprintf(options->xmlOutput, " cipher=\"%s\"", result->cipher);
+	if (result->ticketLifetime >= 0)
+		fprintf(options->xmlOutput, " lifetime=\"%ld\"", result->ticketLifetime);
+	fprintf(options->xmlOutput, " fullms=\"%.2f\"", result->fullTime / 1000.0);
+	if (result->resumed == true)
+		fprintf(options->xmlOutput, " resumedms=\"%.2f\"", result->resumedTime / 1000.0);
+	fprintf(options->xmlOutput, " />\n");
+}
+
+
+// XML: a cipher class of the policy...
+void xmlPolicy(struct sslCheckOptions *options, const struct sslPolicyResult *result)
+{
+	// Variables...
+	const char *status[] = { "pass", "fail", "untested", "error" };
+
+	fprintf(options->xmlOutput, "  <policy class=\"%s\" result=\"%s\" handshakes=\"%d\"", result->policyClass, status[result->status], result->handshakes);
+	if (result->status == policy_fail)
+		fprintf(options->xmlOutput, " sslversion=\"%s\" ciphers=\"%s\"", result->version, result->ciphers);
+	fprintf(options->xmlOutput, " />\n");
+}
+
+
+// XML: the certificate...
+void xmlCertificate(struct sslCheckOptions *options, struct certificateModel *model, const struct sslCertificateResult *result)
+{
+	// Variables...
+	FILE *output = options->xmlOutput;
+	const char *type = 0;
+	int loop;
+
+	// Shown before, refer to it...
+	if (model->sameAs != 0)
+	{
+		fprintf(output, "  <certificate same-as-host=\"%s\" same-as-port=\"%d\" sha256=\"", model->sameAs->host, model->sameAs->port);
+		for (loop = 0; loop < SHA256_DIGEST_LENGTH; loop++)
+			fprintf(output, "%02x", model->fingerprint[loop]);
+		fprintf(output, "\">\n");
+	}
+	else if (model->certificate != NULL)
+	{
+		fprintf(output, "  <certificate sha256=\"");
+		for (loop = 0; loop < SHA256_DIGEST_LENGTH; loop++)
+			fprintf(output, "%02x", model->fingerprint[loop]);
+		fprintf(output, "\">\n");
+	}
+	else
+		fprintf(output, "  <certificate>\n");
+
+	if ((model->certificate != NULL) && (model->sameAs == 0))
+	{
+		fprintf(output, "   <version>%lu</version>\n", model->version);
+		if (model->serial != 0)
+			fprintf(output, "   <serial>%s</serial>\n", model->serial);
+		fprintf(output, "   <signature-algorithm>%s</signature-algorithm>\n", model->signatureAlgorithm);
+		fprintf(output, "   <issuer>%s</issuer>\n", model->issuer);
+		fprintf(output, "   <not-valid-before>%s</not-valid-before>\n", model->notBefore);
+		fprintf(output, "   <not-valid-after>%s</not-valid-after>\n", model->notAfter);
+		fprintf(output, "   <subject>%s</subject>\n", model->subject);
+		fprintf(output, "   <pk-algorithm>%s</pk-algorithm>\n", model->publicKeyAlgorithm);
+
+		// Public Key...
+		if (model->publicKey == NULL)
+			fprintf(output, "   <pk error=\"true\" />\n");
+		else
+		{
+			if (model->publicKeyType == EVP_PKEY_RSA)
+				type = "RSA";
+			else if (model->publicKeyType == EVP_PKEY_DSA)
+				type = "DSA";
+#ifdef OPENSSL_WITH_EC
+			else if (model->publicKeyType == EVP_PKEY_EC)
+				type = "EC";
+#endif
+			if (type == 0)
+				fprintf(output, "   <pk error=\"true\" type=\"unknown\" />\n");
+			else
+			{
+				if (model->publicKeyType == EVP_PKEY_RSA)
+					fprintf(output, "   <pk error=\"false\" type=\"RSA\" bits=\"%d\">\n", model->publicKeyBits);
+				else
+					fprintf(output, "   <pk error=\"false\" type=\"%s\">\n", type);
+				printIndented(output, certificatePublicKey(options, model), 4);
+				fprintf(output, "   </pk>\n");
+			}
+		}
+
+		// X509 v3...
+		if (model->extensionCount > 0)
+		{
+			fprintf(output, "   <X509v3-Extensions>\n");
+			for (loop = 0; loop < model->extensionCount; loop++)
+			{
+				fprintf(output, "    <extension name=\"%s\"%s>", model->extensions[loop].name, model->extensions[loop].critical ? " level=\"critical\"" : "");
+				fprintf(output, "%s</extension>\n", certificateExtensionValue(options, model, loop));
+			}
+			fprintf(output, "   </X509v3-Extensions>\n");
+		}
+	}
+
+	fprintf(output, "  </certificate>\n");
+}
+
+
+// XML: end of a host...
+void xmlHostEnd(struct sslCheckOptions *options, const char *host, int port, int status)
+{
+	fprintf(options->xmlOutput, " </ssltest>\n");
+}
+
+
+// Count: probe outcomes of the current host...
+struct probeCounts
+{
+	int accepted;
+	int rejected;
+	int failed;
+	long long handshakeTime;
+};
+struct probeCounts hostCounts;
+
+
+// Count: enabled with --count...
+int countEnabled(struct sslCheckOptions *options)
+{
+	return (options->count == true);
+}
+
+
+// Count: start of a host...
+void countHostStart(struct sslCheckOptions *options, const char *host, int port)
+{
+	memset(&hostCounts, 0, sizeof(hostCounts));
+}
+
+
+// Count: a cipher probe...
+void countCipher(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	if (result->status == probe_accepted)
+		hostCounts.accepted++;
+	else if (result->status == probe_rejected)
+		hostCounts.rejected++;
+	else
+		hostCounts.failed++;
+	hostCounts.handshakeTime += result->handshakeTime;
+}
+
+
+// Count: end of a host, one line...
+void countHostEnd(struct sslCheckOptions *options, const char *host, int port, int status)
+{
+	// Variables...
+	int probes = hostCounts.accepted + hostCounts.rejected + hostCounts.failed;
+
+	printf("%s:%d accepted=%d rejected=%d failed=%d handshake_avg_ms=%.2f%s\n", host, port, hostCounts.accepted, hostCounts.rejected, hostCounts.failed,
+		(probes > 0) ? hostCounts.handshakeTime / (probes * 1000.0) : 0.0, (status == true) ? "" : " incomplete");
+}
+
+
+// Compact: a certificate was shown for the current host...
+int compactShown = false;
+
+
+// Compact: enabled with --cert-only (unless --quiet)...
+int compactEnabled(struct sslCheckOptions *options)
+{
+	return ((options->certOnly == true) && (options->quiet == false));
+}
+
+
+// Compact: start of a host...
+void compactHostStart(struct sslCheckOptions *options, const char *host, int port)
+{
+	compactShown = false;
+}
+
+
+// Compact: the certificate metadata, one line...
+void compactCertificate(struct sslCheckOptions *options, struct certificateModel *model, const struct sslCertificateResult *result)
+{
+	// Variables...
+	char expires[32] = "unknown";
+	struct tm expiresTime;
+	int loop;
+
+	compactShown = true;
+	if (model->certificate == NULL)
+	{
+		printf("%s:%d error=\"no certificate\"\n", options->host, options->port);
+		return;
+	}
+	if ((model->expires != 0) && (gmtime_r(&model->expires, &expiresTime) != NULL))
+		strftime(expires, sizeof(expires), "%Y-%m-%dT%H:%M:%SZ", &expiresTime);
+
+	printf("%s:%d not_after=%s days_left=%ld verify=\"%s\" sha256=", options->host, options->port, expires, (long)(model->expires - time(NULL)) / 86400,
+		(result->verifyResult == X509_V_OK) ? "ok" : X509_verify_cert_error_string(result->verifyResult));
+	for (loop = 0; loop < SHA256_DIGEST_LENGTH; loop++)
+		printf("%02x", model->fingerprint[loop]);
+	if (result->statusRequested == true)
+		printf(" ocsp=%s", (result->ocspStapled == false) ? "none" : ((result->ocspResponse == NULL) ? "invalid" : "stapled"));
+	printf(" subject=\"%s\" issuer=\"%s\"\n", model->subject, model->issuer);
+}
+
+
+// Compact: end of a host, a line for hosts without a certificate...
+void compactHostEnd(struct sslCheckOptions *options, const char *host, int port, int status)
+{
+	if (compactShown == false)
+		printf("%s:%d error=\"failed\"\n", host, port);
+}
+
+
+// Baseline: the current host...
+struct baselineHost baselineCurrent;
+
+
+// Baseline: add an item to a set (once)...
+void resultSetAdd(struct resultSet *set, const char *item)
+{
+	// Variables...
+	char **items;
+	int loop;
+
+	for (loop = 0; loop < set->count; loop++)
+	{
+		if (strcmp(set->items[loop], item) == 0)
+			return;
+	}
+	if (set->count == set->size)
+	{
+		items = realloc(set->items, (set->size + 32) * sizeof(char *));
+		if (items == NULL)
+			return;
+		set->items = items;
+		set->size += 32;
+	}
+	set->items[set->count] = strdup(item);
+	if (set->items[set->count] != NULL)
+		set->count++;
+}
+
+
+// Baseline: order of two items...
+int resultItemCompare(const void *first, const void *second)
+{
+	return strcmp(*(char * const *)first, *(char * const *)second);
+}
+
+
+// Baseline: order of two items by their protocol version only...
+int resultVersionCompare(const char *first, const char *second)
+{
+	// Variables...
+	int firstLength = strcspn(first, " ");
+	int secondLength = strcspn(second, " ");
+	int order;
+
+	order = strncmp(first, second, (firstLength < secondLength) ? firstLength : secondLength);
+	return (order != 0) ? order : firstLength - secondLength;
+}
+
+
+// Baseline: free the items of a set...
+void resultSetFree(struct resultSet *set)
+{
+	// Variables...
+	int loop;
+
+	for (loop = 0; loop < set->count; loop++)
+		free(set->items[loop]);
+	free(set->items);
+	memset(set, 0, sizeof(struct resultSet));
+}
+
+
+// Baseline: sort the sets of a host, once it is complete...
+void baselineSort(struct baselineHost *host)
+{
+	qsort(host->ciphers.items, host->ciphers.count, sizeof(char *), resultItemCompare);
+	qsort(host->protocols.items, host->protocols.count, sizeof(char *), resultItemCompare);
+	qsort(host->preferred.items, host->preferred.count, sizeof(char *), resultItemCompare);
+	qsort(host->groups.items, host->groups.count, sizeof(char *), resultItemCompare);
+	qsort(host->signatures.items, host->signatures.count, sizeof(char *), resultItemCompare);
+	qsort(host->resumption.items, host->resumption.count, sizeof(char *), resultItemCompare);
+}
+
+
+// Baseline: free the results of a host...
+void baselineHostFree(struct baselineHost *host)
+{
+	free(host->key);
+	resultSetFree(&host->ciphers);
+	resultSetFree(&host->protocols);
+	resultSetFree(&host->preferred);
+	resultSetFree(&host->groups);
+	resultSetFree(&host->signatures);
+	resultSetFree(&host->resumption);
+	host->key = 0;
+	host->certificate[0] = 0;
+}
+
+
+// Baseline: the key of a host...
+char *baselineKey(const char *host, int port, const char *sni)
+{
+	// Variables...
+	char key[BUFFERSIZE];
+
+	if (sni[0] != 0)
+		snprintf(key, sizeof(key), "%s:%d:%s", host, port, sni);
+	else
+		snprintf(key, sizeof(key), "%s:%d", host, port);
+	return strdup(key);
+}
+
+
+// Baseline: hash bucket of a key...
+unsigned int baselineBucket(const char *key)
+{
+	// Variables...
+	unsigned int hash = 5381;
+
+	while (*key != 0)
+		hash = hash * 33 + (unsigned char)*key++;
+	return hash % baseline_buckets;
+}
+
+
+// Baseline: find a host in the baseline (0 if it is not in it)...
+struct baselineHost *baselineFind(const char *key)
+{
+	// Variables...
+	struct baselineHost *host;
+
+	for (host = baseline->buckets[baselineBucket(key)]; host != 0; host = host->next)
+	{
+		if (strcmp(host->key, key) == 0)
+			return host;
+	}
+	return 0;
+}
+
+
+// Baseline: the value of an XML attribute of a line (false if it has none)...
+int xmlAttribute(const char *line, const char *name, char *value, int size)
+{
+	// Variables...
+	char pattern[64];
+	const char *start;
+	int length;
+
+	snprintf(pattern, sizeof(pattern), " %s=\"", name);
+	start = strstr(line, pattern);
+	if (start == NULL)
+		return false;
+	start += strlen(pattern);
+	length = strcspn(start, "\"");
+	if (length >= size)
+		length = size - 1;
+	memcpy(value, start, length);
+	value[length] = 0;
+	return true;
+}
+
+
+// Baseline: load the hosts of an XML result file (may be gzip compressed)...
+int loadBaseline(const char *fileName)
+{
+	// Variables...
+	struct baselineHost *host = 0;
+	gzFile input;
+	char line[BUFFERSIZE * 4];
+	char hostName[512];
+	char port[16];
+	char sni[512];
+	char status[16];
+	char version[32];
+	char cipher[128];
+	char item[160];
+	unsigned int bucket;
+
+	input = gzopen(fileName, "r");
+	baseline = calloc(1, sizeof(struct baselineIndex));
+	if ((input == NULL) || (baseline == NULL))
+	{
+		printf("%sERROR: Could not open baseline file %s.%s\n", COL_RED, fileName, RESET);
+		if (input != NULL)
+			gzclose(input);
+		free(baseline);
+		baseline = 0;
+		return false;
+	}
+
+	// One element per line, as written by the XML output...
+	while (gzgets(input, line, sizeof(line)) != NULL)
+	{
+		if (strstr(line, "<ssltest ") != NULL)
+		{
+			if ((xmlAttribute(line, "host", hostName, sizeof(hostName)) == false) || (xmlAttribute(line, "port", port, sizeof(port)) == false))
+				continue;
+			if (xmlAttribute(line, "sni", sni, sizeof(sni)) == false)
+				sni[0] = 0;
+			host = calloc(1, sizeof(struct baselineHost));
+			if (host == NULL)
+				break;
+			host->key = baselineKey(hostName, atoi(port), sni);
+			host->index = baseline->hosts++;
+			bucket = baselineBucket(host->key);
+			host->next = baseline->buckets[bucket];
+			baseline->buckets[bucket] = host;
+		}
+		else if (host == 0)
+			continue;
+		else if ((strstr(line, "<cipher ") != NULL) && (xmlAttribute(line, "status", status, sizeof(status)) == true) && (strcmp(status, "accepted") == 0)
+			&& (xmlAttribute(line, "sslversion", version, sizeof(version)) == true) && (xmlAttribute(line, "cipher", cipher, sizeof(cipher)) == true))
+		{
+			snprintf(item, sizeof(item), "%s %s", version, cipher);
+			resultSetAdd(&host->ciphers, item);
+			resultSetAdd(&host->protocols, version);
+		}
+		else if ((strstr(line, "<defaultcipher ") != NULL) && (xmlAttribute(line, "sslversion", version, sizeof(version)) == true)
+			&& (xmlAttribute(line, "cipher", cipher, sizeof(cipher)) == true))
+		{
+			snprintf(item, sizeof(item), "%s %s", version, cipher);
+			resultSetAdd(&host->preferred, item);
+		}
+		else if (((strstr(line, "<group ") != NULL) || (strstr(line, "<signature ") != NULL)) && (xmlAttribute(line, "sslversion", version, sizeof(version)) == true)
+			&& (xmlAttribute(line, "name", cipher, sizeof(cipher)) == true))
+		{
+			snprintf(item, sizeof(item), "%s %s", version, cipher);
+			resultSetAdd((strstr(line, "<group ") != NULL) ? &host->groups : &host->signatures, item);
+		}
+		else if ((strstr(line, "<resumption ") != NULL) && (xmlAttribute(line, "resumed", status, sizeof(status)) == true) && (strcmp(status, "true") == 0)
+			&& (xmlAttribute(line, "sslversion", version, sizeof(version)) == true) && (xmlAttribute(line, "method", cipher, sizeof(cipher)) == true))
+		{
+			snprintf(item, sizeof(item), "%s %s", version, cipher);
+			resultSetAdd(&host->resumption, item);
+		}
+		else if (strstr(line, "<certificate") != NULL)
+			xmlAttribute(line, "sha256", host->certificate, sizeof(host->certificate));
+		else if (strstr(line, "</ssltest>") != NULL)
+		{
+			baselineSort(host);
+			host = 0;
+		}
+	}
+	gzclose(input);
+
+	// Counts and seen flags, in memory the workers share...
+	baseline->summary = mmap(NULL, 3 * sizeof(long) + baseline->hosts + 1, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (baseline->summary == MAP_FAILED)
+	{
+		printf("%sERROR: Could not load baseline file %s.%s\n", COL_RED, fileName, RESET);
+		return false;
+	}
+	baseline->seen = (char *)(baseline->summary + 3);
+	return true;
+}
+
+
+// Baseline: print the differences of two sorted sets...
+//   byVersion compares the items by protocol only (preferred ciphers),
+//   so that another cipher for a protocol is a change.
+int baselineDiff(const char *key, const char *label, struct resultSet *before, struct resultSet *after, int byVersion)
+{
+	// Variables...
+	int changes = 0;
+	int old = 0;
+	int new = 0;
+	int order;
+
+	while ((old < before->count) || (new < after->count))
+	{
+		if (old == before->count)
+			order = 1;
+		else if (new == after->count)
+			order = -1;
+		else if (byVersion == true)
+			order = resultVersionCompare(before->items[old], after->items[new]);
+		else
+			order = strcmp(before->items[old], after->items[new]);
+
+		if (order < 0)
+			printf("%s removed %s %s\n", key, label, before->items[old++]);
+		else if (order > 0)
+			printf("%s added %s %s\n", key, label, after->items[new++]);
+		else
+		{
+			if (strcmp(before->items[old], after->items[new]) != 0)
+				printf("%s changed %s %s -> %s\n", key, label, before->items[old], after->items[new] + strcspn(after->items[new], " ") + 1);
+			else
+				changes--;
+			old++;
+			new++;
+		}
+		changes++;
+	}
+	return changes;
+}
+
+
+// Baseline: enabled with --baseline...
+int baselineEnabled(struct sslCheckOptions *options)
+{
+	return (baseline != 0);
+}
+
+
+// Baseline: start of a host...
+void baselineHostStart(struct sslCheckOptions *options, const char *host, int port)
+{
+	baselineHostFree(&baselineCurrent);
+	baselineCurrent.key = baselineKey(host, port, (options->sniEnable == true) ? options->sniServername : "");
+}
+
+
+// Baseline: a cipher probe...
+void baselineCipher(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	// Variables...
+	char item[160];
+
+	if (result->status != probe_accepted)
+		return;
+	snprintf(item, sizeof(item), "%s %s", result->version, result->cipher);
+	resultSetAdd(&baselineCurrent.ciphers, item);
+	resultSetAdd(&baselineCurrent.protocols, result->version);
+}
+
+
+// Baseline: a preferred cipher...
+void baselinePreferred(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	// Variables...
+	char item[160];
+
+	snprintf(item, sizeof(item), "%s %s", result->version, result->cipher);
+	resultSetAdd(&baselineCurrent.preferred, item);
+}
+
+
+// Baseline: a key exchange group or signature algorithm...
+void baselineExchange(struct sslCheckOptions *options, const struct sslExchangeResult *result)
+{
+	// Variables...
+	char item[160];
+
+	snprintf(item, sizeof(item), "%s %s", result->version, result->name);
+	resultSetAdd((result->kind == exchange_group) ? &baselineCurrent.groups : &baselineCurrent.signatures, item);
+}
+
+
+// Baseline: session resumption, only the methods that resumed...
+void baselineResumption(struct sslCheckOptions *options, const struct sslResumptionResult *result)
+{
+	// Variables...
+	char item[160];
+
+	if (result->resumed == false)
+		return;
+	snprintf(item, sizeof(item), "%s %s", result->version, (result->method == resumption_ticket) ? "ticket" : "sessionid");
+	resultSetAdd(&baselineCurrent.resumption, item);
+}
+
+
+// Baseline: the certificate...
+void baselineCertificate(struct sslCheckOptions *options, struct certificateModel *model, const struct sslCertificateResult *result)
+{
+	// Variables...
+	int loop;
+
+	if (model->certificate == NULL)
+		return;
+	for (loop = 0; loop < SHA256_DIGEST_LENGTH; loop++)
+		sprintf(baselineCurrent.certificate + loop * 2, "%02x", model->fingerprint[loop]);
+}
+
+
+// Baseline: end of a host, print what changed...
+void baselineHostEnd(struct sslCheckOptions *options, const char *host, int port, int status)
+{
+	// Variables...
+	struct baselineHost *before;
+	const char *key = baselineCurrent.key;
+	int changes = 0;
+
+	if (key == 0)
+		return;
+	before = baselineFind(key);
+	if (before == 0)
+	{
+		printf("%s added host\n", key);
+		__sync_fetch_and_add(&baseline->summary[baseline_new], 1);
+		return;
+	}
+	baseline->seen[before->index] = true;
+
+	baselineSort(&baselineCurrent);
+	changes += baselineDiff(key, "protocol", &before->protocols, &baselineCurrent.protocols, false);
+	changes += baselineDiff(key, "cipher", &before->ciphers, &baselineCurrent.ciphers, false);
+	changes += baselineDiff(key, "preferred", &before->preferred, &baselineCurrent.preferred, true);
+	changes += baselineDiff(key, "group", &before->groups, &baselineCurrent.groups, false);
+	changes += baselineDiff(key, "signature", &before->signatures, &baselineCurrent.signatures, false);
+	changes += baselineDiff(key, "resumption", &before->resumption, &baselineCurrent.resumption, false);
+	if (strcmp(before->certificate, baselineCurrent.certificate) != 0)
+	{
+		if (before->certificate[0] == 0)
+			printf("%s added certificate %s\n", key, baselineCurrent.certificate);
+		else if (baselineCurrent.certificate[0] == 0)
+			printf("%s removed certificate %s\n", key, before->certificate);
+		else
+			printf("%s changed certificate %s -> %s\n", key, before->certificate, baselineCurrent.certificate);
+		changes++;
+	}
+
+	// A scan that did not complete may show removals that are none...
+	if ((changes > 0) && (status == false))
+		printf("%s incomplete\n", key);
+	__sync_fetch_and_add(&baseline->summary[(changes > 0) ? baseline_changed : baseline_unchanged], 1);
+}
+
+
+// Baseline: the summary, after all hosts...
+void baselineSummary()
+{
+	// Variables...
+	int missing = 0;
+	int loop;
+
+	for (loop = 0; loop < baseline->hosts; loop++)
+	{
+		if (baseline->seen[loop] == false)
+			missing++;
+	}
+	printf("Baseline: %ld unchanged, %ld changed, %ld added, %d not scanned.\n", baseline->summary[baseline_unchanged], baseline->summary[baseline_changed],
+		baseline->summary[baseline_new], missing);
+}
+
+
+// Baseline: free the index...
+void freeBaseline()
+{
+	// Variables...
+	struct baselineHost *host;
+	int loop;
+
+	baselineHostFree(&baselineCurrent);
+	for (loop = 0; loop < baseline_buckets; loop++)
+	{
+		while (baseline->buckets[loop] != 0)
+		{
+			host = baseline->buckets[loop]->next;
+			baselineHostFree(baseline->buckets[loop]);
+			free(baseline->buckets[loop]);
+			baseline->buckets[loop] = host;
+		}
+	}
+	munmap(baseline->summary, 3 * sizeof(long) + baseline->hosts + 1);
+	free(baseline);
+	baseline = 0;
+}
+
+
+// Load test: an accepted cipher of the host (--loadtest)...
+struct loadCipher
+{
+	char name[64];
+	int sslVersion;
+	int bits;
+};
+struct loadCipher loadCiphers[loadtest_ciphers_max];
+int loadCipherCount = 0;
+int loadSeconds = 0;
+
+
+// Load test: enabled with --loadtest...
+int loadtestEnabled(struct sslCheckOptions *options)
+{
+	return (loadSeconds > 0);
+}
+
+
+// Load test: start of a host...
+void loadtestHostStart(struct sslCheckOptions *options, const char *host, int port)
+{
+	loadCipherCount = 0;
+}
+
+
+// Load test: keep the accepted ciphers...
+void loadtestCipher(struct sslCheckOptions *options, const struct sslCipherResult *result)
+{
+	if ((result->status != probe_accepted) || (loadCipherCount == loadtest_ciphers_max))
+		return;
+
+	// Raw records only detect SSLv2 and SSLv3, they can not be driven
+#ifdef LEGACY_SSLv2
+	if (result->sslVersion == ssl_v2)
+		return;
+#endif
+#ifdef LEGACY_SSLv3
+	if (result->sslVersion == ssl_v3)
+		return;
+#endif
+	snprintf(loadCiphers[loadCipherCount].name, sizeof(loadCiphers[loadCipherCount].name), "%s", result->cipher);
+	loadCiphers[loadCipherCount].sslVersion = result->sslVersion;
+	loadCiphers[loadCipherCount].bits = result->bits;
+	loadCipherCount++;
+}
+
+
+// Command line: the output formats...
+const struct outputRenderer textRenderer = { textEnabled, textHostStart, textCipher, textPreferredStart, textPreferred, textCertificate, 0, textPolicy, textExchange, textResumption };
+const struct outputRenderer xmlRenderer = { xmlEnabled, xmlHostStart, xmlCipher, 0, xmlPreferred, xmlCertificate, xmlHostEnd, xmlPolicy, xmlExchange, xmlResumption };
+const struct outputRenderer countRenderer = { countEnabled, countHostStart, countCipher, 0, 0, 0, countHostEnd };
+const struct outputRenderer compactRenderer = { compactEnabled, compactHostStart, 0, 0, 0, compactCertificate, compactHostEnd };
+const struct outputRenderer baselineRenderer = { baselineEnabled, baselineHostStart, baselineCipher, 0, baselinePreferred, baselineCertificate, baselineHostEnd, 0, baselineExchange, baselineResumption };
+const struct outputRenderer loadtestRenderer = { loadtestEnabled, loadtestHostStart, loadtestCipher };
+const struct outputRenderer *outputRenderers[] = { &xmlRenderer, &textRenderer, &countRenderer, &compactRenderer, &baselineRenderer, &loadtestRenderer, 0 };
+
+
+// Command line: start of a host...
+void printHostStart(void *userData, const char *host, int port)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->hostStart != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->hostStart(options, host, port);
+	}
+}
+
+
+// Command line: a cipher probe...
+void printCipher(void *userData, const struct sslCipherResult *result)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->cipher != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->cipher(options, result);
+	}
+}
+
+
+// Command line: start of the preferred ciphers...
+void printPreferredStart(void *userData)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->preferredStart != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->preferredStart(options);
+	}
+}
+
+
+// Command line: a preferred cipher...
+void printPreferred(void *userData, const struct sslCipherResult *result)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->preferred != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->preferred(options, result);
+	}
+}
+
+
+// Command line: the certificate...
+//   It is decoded once for all enabled renderers, not at all if none is.
+void printCertificate(void *userData, const struct sslCertificateResult *result)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+	struct certificateModel model;
+	int enabled = false;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->certificate != 0) && ((*renderer)->enabled(options) == true))
+			enabled = true;
+	}
+	if (enabled == false)
+		return;
+
+	memset(&model, 0, sizeof(model));
+	if (result->certificate != NULL)
+	{
+		buildCertificateModel(options, &model, result->certificate);
+		model.sameAs = certificateShownFor(options, &model);
+	}
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->certificate != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->certificate(options, &model, result);
+	}
+	freeCertificateModel(&model);
+}
+
+
+// Command line: end of a host...
+void printHostEnd(void *userData, const char *host, int port, int status)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->hostEnd != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->hostEnd(options, host, port, status);
+	}
+}
+
+
+// Command line: a cipher class of the policy...
+void printPolicy(void *userData, const struct sslPolicyResult *result)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->policy != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->policy(options, result);
+	}
+}
+
+
+// Command line: a key exchange group or signature algorithm...
+void printExchange(void *userData, const struct sslExchangeResult *result)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->exchange != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->exchange(options, result);
+	}
+}
+
+
+// Command line: session resumption with a protocol and method...
+void printResumption(void *userData, const struct sslResumptionResult *result)
+{
+	// Variables...
+	struct sslCheckOptions *options = userData;
+	const struct outputRenderer **renderer;
+
+	for (renderer = outputRenderers; *renderer != 0; renderer++)
+	{
+		if (((*renderer)->resumption != 0) && ((*renderer)->enabled(options) == true))
+			(*renderer)->resumption(options, result);
+	}
+}
+
+
+// Command line: text and XML output...
+const struct sslScanCallbacks printCallbacks = { printHostStart, printCipher, printPreferredStart, printPreferred, printCertificate, printHostEnd, printError, printPolicy, printExchange, printResumption };
+
+
+// Write a Prometheus metric header...
+void metricsHeader(FILE *output, const char *name, const char *type, const char *help)
+{
+	fprintf(output, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+
+// Write the metrics in Prometheus text format...
+void writeMetrics(FILE *output, struct scanMetrics *metrics, pid_t scanPid)
+{
+	// Variables...
+	FILE *statmFile;
+	char fileName[64];
+	long pages = 0;
+	long long now;
+	long handshakes;
+	long cumulative;
+	int phase;
+	int bucket;
+
+	metricsHeader(output, "sslscan_probes_started_total", "counter", "Probe connections started.");
+	fprintf(output, "sslscan_probes_started_total %ld\n", metrics->probesStarted);
+	metricsHeader(output, "sslscan_probes_accepted_total", "counter", "Probe handshakes accepted by the server.");
+	fprintf(output, "sslscan_probes_accepted_total %ld\n", metrics->probesAccepted);
+	metricsHeader(output, "sslscan_probes_rejected_total", "counter", "Probe handshakes rejected by the server.");
+	fprintf(output, "sslscan_probes_rejected_total %ld\n", metrics->probesRejected);
+	metricsHeader(output, "sslscan_probes_failed_total", "counter", "Probes that failed to connect or to complete the handshake.");
+	fprintf(output, "sslscan_probes_failed_total %ld\n", metrics->probesFailed);
+	metricsHeader(output, "sslscan_probes_timed_out_total", "counter", "Failed probes that ran into a timeout.");
+	fprintf(output, "sslscan_probes_timed_out_total %ld\n", metrics->probesTimedOut);
+	metricsHeader(output, "sslscan_probes_retried_total", "counter", "Retries of probes that failed transiently.");
+	fprintf(output, "sslscan_probes_retried_total %ld\n", metrics->probesRetried);
+	metricsHeader(output, "sslscan_handshakes_total", "counter", "TLS handshakes attempted.");
+	fprintf(output, "sslscan_handshakes_total %ld\n", metrics->handshakes);
+
+	// Handshake rate since the previous exposition...
+	now = timeMicroseconds();
+	handshakes = metrics->handshakes;
+	metricsHeader(output, "sslscan_handshakes_per_second", "gauge", "TLS handshakes per second since the previous exposition.");
+	if ((metrics->rateTime != 0) && (now > metrics->rateTime))
+		fprintf(output, "sslscan_handshakes_per_second %.3f\n", (double)(handshakes - metrics->rateHandshakes) * 1000000.0 / (double)(now - metrics->rateTime));
+	else
+		fprintf(output, "sslscan_handshakes_per_second 0\n");
+	metrics->rateHandshakes = handshakes;
+	metrics->rateTime = now;
+
+	metricsHeader(output, "sslscan_connections_in_flight", "gauge", "Open probe connections.");
+	fprintf(output, "sslscan_connections_in_flight %ld\n", metrics->connectionsInFlight);
+	metricsHeader(output, "sslscan_queue_depth", "gauge", "Targets or daemon jobs not yet completed.");
+	fprintf(output, "sslscan_queue_depth %ld\n", metrics->queueDepth);
+
+	// Phase latency histograms...
+	metricsHeader(output, "sslscan_phase_duration_seconds", "histogram", "Latency of the probe phases.");
+	for (phase = 0; phase < phase_count; phase++)
+	{
+		cumulative = 0;
+		for (bucket = 0; bucket < metrics_buckets; bucket++)
+		{
+			cumulative += metrics->phaseBuckets[phase][bucket];
+			fprintf(output, "sslscan_phase_duration_seconds_bucket{phase=\"%s\",le=\"%g\"} %ld\n", phaseNames[phase], (double)metricsBuckets[bucket] / 1000000.0, cumulative);
+		}
+		fprintf(output, "sslscan_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %ld\n", phaseNames[phase], metrics->phaseCount[phase]);
+		fprintf(output, "sslscan_phase_duration_seconds_sum{phase=\"%s\"} %.6f\n", phaseNames[phase], (double)metrics->phaseSum[phase] / 1000000.0);
+		fprintf(output, "sslscan_phase_duration_seconds_count{phase=\"%s\"} %ld\n", phaseNames[phase], metrics->phaseCount[phase]);
+	}
+
+	// Resident memory of the scanner...
+	snprintf(fileName, sizeof(fileName), "/proc/%d/statm", (int)scanPid);
+	statmFile = fopen(fileName, "r");
+	if (statmFile != NULL)
+	{
+		if (fscanf(statmFile, "%*d %ld", &pages) != 1)
+			pages = 0;
+		fclose(statmFile);
+		metricsHeader(output, "process_resident_memory_bytes", "gauge", "Resident memory of the scanning process.");
+		fprintf(output, "process_resident_memory_bytes %ld\n", pages * sysconf(_SC_PAGESIZE));
+	}
+}
+
+
+// Write the metrics file (atomically, for textfile collectors)...
+void writeMetricsFile(char *metricsFile, struct scanMetrics *metrics, pid_t scanPid)
+{
+	// Variables...
+	char tempFile[1024];
+	FILE *output;
+
+	snprintf(tempFile, sizeof(tempFile), "%s.tmp", metricsFile);
+	output = fopen(tempFile, "w");
+	if (output == NULL)
+		return;
+	writeMetrics(output, metrics, scanPid);
+	fclose(output);
+	rename(tempFile, metricsFile);
+}
+
+
+// Metrics process, serves HTTP scrapes and writes the metrics file...
+void metricsLoop(struct scanMetrics *metrics, int listenDescriptor, char *metricsFile, int interval, pid_t scanPid)
+{
+	// Variables...
+	struct pollfd pollDescriptor;
+	long long nextWrite;
+	long long now;
+	int clientDescriptor;
+	int timeout;
+	char request[BUFFERSIZE];
+	FILE *client;
+
+	nextWrite = timeMicroseconds();
+	while (getppid() == scanPid)
+	{
+		// Periodic metrics file...
+		now = timeMicroseconds();
+		if ((metricsFile != 0) && (now >= nextWrite))
+		{
+			writeMetricsFile(metricsFile, metrics, scanPid);
+			nextWrite = now + (long long)interval * 1000000;
+		}
+
+		// Wait for a scrape (and check on the scanner every second)...
+		timeout = 1000;
+		if ((metricsFile != 0) && ((nextWrite - now) / 1000 < timeout))
+			timeout = (nextWrite - now) / 1000;
+		pollDescriptor.fd = listenDescriptor;
+		pollDescriptor.events = POLLIN;
+		pollDescriptor.revents = 0;
+		if (poll(&pollDescriptor, (listenDescriptor >= 0) ? 1 : 0, timeout) <= 0)
+			continue;
+
+		clientDescriptor = accept(listenDescriptor, NULL, NULL);
+		if (clientDescriptor < 0)
+			continue;
+
+		// Any request gets the metrics...
+		pollDescriptor.fd = clientDescriptor;
+		if (poll(&pollDescriptor, 1, 1000) > 0)
+			recv(clientDescriptor, request, sizeof(request), 0);
+		client = fdopen(clientDescriptor, "w");
+		if (client == NULL)
+		{
+			close(clientDescriptor);
+			continue;
+		}
+		fprintf(client, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+		writeMetrics(client, metrics, scanPid);
+		fclose(client);
+	}
+}
+
+
+// Set up the shared metrics and start the metrics process...
+pid_t startMetrics(struct sslCheckOptions *options, char *metricsListen, char *metricsFile, int interval)
+{
+	// Variables...
+	struct sockaddr_in metricsAddress;
+	char address[64];
+	char *port;
+	int listenDescriptor = -1;
+	int reuse = 1;
+	pid_t pid;
+
+	// Shared counters...
+	options->metrics = mmap(NULL, sizeof(struct scanMetrics), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (options->metrics == MAP_FAILED)
+	{
+		options->metrics = 0;
+		printf("%sERROR: Could not allocate the metrics.%s\n", COL_RED, RESET);
+		return -1;
+	}
+	memset(options->metrics, 0, sizeof(struct scanMetrics));
+
+	// HTTP listener ([address:]port, local by default)...
+	if (metricsListen != 0)
+	{
+		memset(&metricsAddress, 0, sizeof(metricsAddress));
+		metricsAddress.sin_family = AF_INET;
+		metricsAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		port = strrchr(metricsListen, ':');
+		if (port != NULL)
+		{
+			snprintf(address, sizeof(address), "%.*s", (int)(port - metricsListen), metricsListen);
+			if (inet_aton(address, &metricsAddress.sin_addr) == 0)
+			{
+				printf("%sERROR: Invalid metrics address %s.%s\n", COL_RED, address, RESET);
+				return -1;
+			}
+			port++;
+		}
+		else
+			port = metricsListen;
+		metricsAddress.sin_port = htons(atoi(port));
+
+		listenDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+		if (listenDescriptor >= 0)
+			setsockopt(listenDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		if ((listenDescriptor < 0) || (bind(listenDescriptor, (struct sockaddr *) &metricsAddress, sizeof(metricsAddress)) < 0) || (listen(listenDescriptor, 16) < 0))
+		{
+			printf("%sERROR: Could not listen for metrics on %s.%s\n", COL_RED, metricsListen, RESET);
+			if (listenDescriptor >= 0)
+				close(listenDescriptor);
+			return -1;
+		}
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0)
+	{
+		metricsLoop(options->metrics, listenDescriptor, metricsFile, interval, getppid());
+		_exit(0);
+	}
+	if (listenDescriptor >= 0)
+		close(listenDescriptor);
+	return pid;
+}
+
+
+// Stop the metrics process and write the final metrics file...
+void stopMetrics(struct sslCheckOptions *options, pid_t metricsPid, char *metricsFile)
+{
+	if (metricsPid > 0)
+	{
+		kill(metricsPid, SIGTERM);
+		waitpid(metricsPid, NULL, 0);
+	}
+	if ((metricsFile != 0) && (options->metrics != 0))
+		writeMetricsFile(metricsFile, options->metrics, getpid());
+}
+
+
+// Daemon scan job...
+struct daemonJob
+{
+	char id[128];
+	char target[512];
+	char *args[64];
+	int argCount;
+	int xml;
+	char strings[BUFFERSIZE * 8];
+	int stringsUsed;
+};
+
+
+// Skip JSON white space...
+char *jsonSkip(char *json)
+{
+	while ((*json == ' ') || (*json == '\t') || (*json == '\r') || (*json == '\n'))
+		json++;
+	return json;
+}
+
+
+// Parse a JSON string, returns a pointer after the closing quote...
+char *jsonParseString(char *json, char *output, int maxSize)
+{
+	// Variables...
+	int outputLength = 0;
+	unsigned int codePoint;
+	char character;
+
+	if (*json != '"')
+		return NULL;
+	json++;
+	while (*json != '"')
+	{
+		if (*json == 0)
+			return NULL;
+		character = *json++;
+		if (character == '\\')
+		{
+			character = *json++;
+			switch (character)
+			{
+				case 'b': character = '\b'; break;
+				case 'f': character = '\f'; break;
+				case 'n': character = '\n'; break;
+				case 'r': character = '\r'; break;
+				case 't': character = '\t'; break;
+				case 'u':
+					if (sscanf(json, "%4x", &codePoint) != 1)
+						return NULL;
+					json += 4;
+					character = (codePoint < 0x80) ? (char)codePoint : '?';
+					break;
+				case '"':
+				case '\\':
+				case '/':
+					break;
+				default:
+					return NULL;
+			}
+		}
+		if (outputLength < maxSize - 1)
+			output[outputLength++] = character;
+	}
+	output[outputLength] = 0;
+	return json + 1;
+}
+
+
+// Parse a daemon job line...
+//   {"id":"1","target":"host:port","args":["--tls1_2","--http"],"xml":true}
+const char *parseJob(char *line, struct daemonJob *job)
+{
+	// Variables...
+	char key[32];
+	char *json;
+	char *number;
+
+	memset(job, 0, sizeof(struct daemonJob));
+	json = jsonSkip(line);
+	if (*json != '{')
+		return "job is not a JSON object";
+	json = jsonSkip(json + 1);
+	while (*json != '}')
+	{
+		// Key...
+		json = jsonParseString(json, key, sizeof(key));
+		if (json == NULL)
+			return "invalid key";
+		json = jsonSkip(json);
+		if (*json != ':')
+			return "missing ':'";
+		json = jsonSkip(json + 1);
+
+		// Value...
+		if (strcmp(key, "id") == 0)
+		{
+			if (*json == '"')
+				json = jsonParseString(json, job->id, sizeof(job->id));
+			else
+			{
+				number = job->id;
+				while ((((*json >= '0') && (*json <= '9')) || (*json == '-')) && (number < job->id + sizeof(job->id) - 1))
+					*number++ = *json++;
+			}
+		}
+		else if (strcmp(key, "target") == 0)
+			json = jsonParseString(json, job->target, sizeof(job->target));
+		else if (strcmp(key, "xml") == 0)
+		{
+			if (strncmp(json, "true", 4) == 0)
+			{
+				job->xml = true;
+				json += 4;
+			}
+			else if (strncmp(json, "false", 5) == 0)
+				json += 5;
+			else
+				return "xml must be true or false";
+		}
+		else if (strcmp(key, "args") == 0)
+		{
+			if (*json != '[')
+				return "args must be an array";
+			json = jsonSkip(json + 1);
+			while (*json != ']')
+			{
+				if (job->argCount == (sizeof(job->args) / sizeof(job->args[0])))
+					return "too many args";
+				job->args[job->argCount] = job->strings + job->stringsUsed;
+				json = jsonParseString(json, job->args[job->argCount], sizeof(job->strings) - job->stringsUsed);
+				if (json == NULL)
+					return "args must be strings";
+				job->stringsUsed += strlen(job->args[job->argCount]) + 1;
+				job->argCount++;
+				json = jsonSkip(json);
+				if (*json == ',')
+					json = jsonSkip(json + 1);
+				else if (*json != ']')
+					return "missing ','";
+			}
+			json++;
+		}
+		else
+			return "unknown key";
+		if (json == NULL)
+			return "invalid value";
+
+		json = jsonSkip(json);
+		if (*json == ',')
+			json = jsonSkip(json + 1);
+		else if (*json != '}')
+			return "missing ','";
+	}
+
+	if (job->target[0] == 0)
+		return "missing target";
+	return NULL;
+}
+
+
+// Write a daemon result record...
+void daemonRecord(FILE *client, struct daemonJob *job, const char *key, const char *value)
+{
+	fprintf(client, "{\"id\":");
+	jsonString(client, job->id);
+	fprintf(client, ",\"%s\":", key);
+	jsonString(client, value);
+	fprintf(client, "}\n");
+}
+
+
+// Apply a job to the daemon options and scan it (job process)...
+int daemonScan(struct sslCheckOptions *options, struct daemonJob *job)
+{
+	// Variables...
+	int sslVersion = options->sslVersion;
+	int argLoop;
+	char *port;
+
+	// Reset the per-job options...
+	options->port = 443;
+	options->noFailed = false;
+	options->esmtps = false;
+	options->ftps = false;
+	options->ftps_dcs = false;
+	options->pop3s = false;
+	options->imaps = false;
+	options->sslVersion = ssl_none;
+	options->pout = false;
+	options->sslbugs = false;
+	options->http = false;
+	options->sniEnable = false;
+	options->OCSPStatusRequest = false;
+	options->smtpPipelining = false;
+	options->certOnly = false;
+	options->groups = false;
+	options->sigalgs = false;
+	options->resumption = false;
+	options->sniServername = "";
+	options->traceOutput = 0;
+
+	// Job options...
+	for (argLoop = 0; argLoop < job->argCount; argLoop++)
+	{
+		if (parseScanOption(options, job->args[argLoop]) == false)
+		{
+			printf("ERROR: Unsupported job option %s.\n", job->args[argLoop]);
+			return -1;
+		}
+	}
+	if (options->sslVersion == ssl_none)
+		options->sslVersion = sslVersion;
+
+	// Host and port...
+	port = strchr(job->target, ':');
+	if (port != NULL)
+	{
+		*port = 0;
+		options->port = atoi(port + 1);
+	}
+	options->host = arenaString(options, job->target);
+	if ((options->sniEnable == true) && (options->sniServername[0] == 0))
+		options->sniServername = options->host;
+
+	return testHost(options);
+}
+
+
+// Run a daemon job and stream its results to the client...
+int daemonRunJob(struct sslCheckOptions *options, struct daemonJob *job, FILE *client)
+{
+	// Variables...
+	int outputPipe[2];
+	int xmlPipe[2] = { -1, -1 };
+	struct pollfd pollDescriptors[2];
+	char buffers[2][BUFFERSIZE];
+	int used[2] = { 0, 0 };
+	const char *keys[2] = { "output", "xml" };
+	int streams;
+	int loop;
+	int readSize;
+	char *newLine;
+	int status;
+	pid_t pid;
+
+	if (pipe(outputPipe) != 0)
+		return false;
+	if ((job->xml == true) && (pipe(xmlPipe) != 0))
+	{
+		close(outputPipe[0]);
+		close(outputPipe[1]);
+		return false;
+	}
+
+	// Job process, inherits the loaded ciphers and contexts...
+	fflush(client);
+	pid = fork();
+	if (pid == 0)
+	{
+		close(outputPipe[0]);
+		dup2(outputPipe[1], 1);
+		close(outputPipe[1]);
+		options->xmlOutput = 0;
+		if (job->xml == true)
+		{
+			close(xmlPipe[0]);
+			options->xmlOutput = fdopen(xmlPipe[1], "w");
+		}
+		status = daemonScan(options, job);
+		fflush(stdout);
+		if (options->xmlOutput != 0)
+			fclose(options->xmlOutput);
+		_exit((status == true) ? 0 : ((status == false) ? 1 : 2));
+	}
+	close(outputPipe[1]);
+	if (job->xml == true)
+		close(xmlPipe[1]);
+	if (pid < 0)
+	{
+		close(outputPipe[0]);
+		if (job->xml == true)
+			close(xmlPipe[0]);
+		return false;
+	}
+
+	// Relay output lines...
+	pollDescriptors[0].fd = outputPipe[0];
+	pollDescriptors[1].fd = xmlPipe[0];
+	streams = (job->xml == true) ? 2 : 1;
+	while ((pollDescriptors[0].fd >= 0) || ((streams == 2) && (pollDescriptors[1].fd >= 0)))
+	{
+		for (loop = 0; loop < 2; loop++)
+		{
+			pollDescriptors[loop].events = POLLIN;
+			pollDescriptors[loop].revents = 0;
+		}
+		if (poll(pollDescriptors, streams, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (loop = 0; loop < streams; loop++)
+		{
+			if ((pollDescriptors[loop].fd < 0) || (pollDescriptors[loop].revents == 0))
+				continue;
+			readSize = read(pollDescriptors[loop].fd, buffers[loop] + used[loop], BUFFERSIZE - 1 - used[loop]);
+			if (readSize > 0)
+				used[loop] += readSize;
+			buffers[loop][used[loop]] = 0;
+			while ((newLine = strchr(buffers[loop], '\n')) != NULL)
+			{
+				*newLine = 0;
+				daemonRecord(client, job, keys[loop], buffers[loop]);
+				used[loop] -= newLine + 1 - buffers[loop];
+				memmove(buffers[loop], newLine + 1, used[loop] + 1);
+			}
+			if ((used[loop] > 0) && ((readSize <= 0) || (used[loop] == BUFFERSIZE - 1)))
+			{
+				daemonRecord(client, job, keys[loop], buffers[loop]);
+				used[loop] = 0;
+			}
+			if (readSize <= 0)
+			{
+				close(pollDescriptors[loop].fd);
+				pollDescriptors[loop].fd = -1;
+			}
+		}
+		fflush(client);
+	}
+
+	// Job status...
+	waitpid(pid, &status, 0);
+	if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+		daemonRecord(client, job, "status", "ok");
+	else if (WIFEXITED(status) && (WEXITSTATUS(status) == 1))
+		daemonRecord(client, job, "status", "failed");
+	else
+		daemonRecord(client, job, "status", "error");
+	fflush(client);
+
+	return true;
+}
+
+
+// Serve the jobs of one client connection...
+void daemonClient(struct sslCheckOptions *options, int clientDescriptor)
+{
+	// Variables...
+	FILE *input;
+	FILE *client;
+	struct daemonJob job;
+	const char *error;
+	char line[BUFFERSIZE * 8];
+	int length;
+
+	input = fdopen(clientDescriptor, "r");
+	client = fdopen(dup(clientDescriptor), "w");
+	if ((input == NULL) || (client == NULL))
+		return;
+
+	while (fgets(line, sizeof(line), input) != NULL)
+	{
+		// Overlong line, skip the rest of it...
+		length = strlen(line);
+		if ((length == sizeof(line) - 1) && (line[length - 1] != '\n'))
+		{
+			while ((fgets(line, sizeof(line), input) != NULL) && (line[strlen(line) - 1] != '\n'))
+				;
+			memset(&job, 0, sizeof(job));
+			daemonRecord(client, &job, "error", "job too long");
+			fflush(client);
+			continue;
+		}
+		if (*jsonSkip(line) == 0)
+			continue;
+
+		error = parseJob(line, &job);
+		if (error != NULL)
+		{
+			daemonRecord(client, &job, "error", error);
+			fflush(client);
+		}
+		else
+		{
+			metricsAdd(options, queueDepth, 1);
+			if (daemonRunJob(options, &job, client) == false)
+			{
+				daemonRecord(client, &job, "error", "could not start job");
+				fflush(client);
+			}
+			metricsAdd(options, queueDepth, -1);
+		}
+	}
+
+	fclose(client);
+	fclose(input);
+}
+
+
+// Daemon mode, accept scan jobs on a Unix domain socket...
+int daemonLoop(struct sslCheckOptions *options, char *socketPath)
+{
+	// Variables...
+	struct sslCipher *sslCipherPointer;
+	struct sockaddr_un address;
+	int listenDescriptor;
+	int clientDescriptor;
+	pid_t pid;
+
+	// Job output is relayed as data, no colours...
+	RESET = "";
+	COL_RED = "";
+	COL_BLUE = "";
+	COL_GREEN = "";
+	printf("\n");
+
+	// Warm up the contexts for every method (and the trusted CAs)...
+	for (sslCipherPointer = cipherCatalog; sslCipherPointer != 0; sslCipherPointer = sslCipherPointer->next)
+	{
+		if (getContext(options, sslCipherPointer->sslMethod, false) == NULL)
+			return false;
+	}
+	if (getContext(options, SSLv23_method(), true) == NULL)
+		return false;
+
+	// Listen...
+	if (strlen(socketPath) >= sizeof(address.sun_path))
+	{
+		printf("%sERROR: Daemon socket path %s is too long.%s\n", COL_RED, socketPath, RESET);
+		return false;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath);
+	listenDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenDescriptor < 0)
+	{
+		printf("%sERROR: Could not open a socket.%s\n", COL_RED, RESET);
+		return false;
+	}
+	unlink(socketPath);
+	if ((bind(listenDescriptor, (struct sockaddr *) &address, sizeof(address)) < 0) || (listen(listenDescriptor, 16) < 0))
+	{
+		printf("%sERROR: Could not listen on %s.%s\n", COL_RED, socketPath, RESET);
+		close(listenDescriptor);
+		return false;
+	}
+	printf("Listening for scan jobs on %s\n", socketPath);
+	fflush(stdout);
+
+	// One process per client connection...
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGCHLD, SIG_IGN);
+	while (true)
+	{
+		clientDescriptor = accept(listenDescriptor, NULL, NULL);
+		if (clientDescriptor < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			printf("%sERROR: Could not accept a connection.%s\n", COL_RED, RESET);
+			break;
+		}
+		pid = fork();
+		if (pid == 0)
+		{
+			close(listenDescriptor);
+			signal(SIGCHLD, SIG_DFL);
+			daemonClient(options, clientDescriptor);
+			_exit(0);
+		}
+		close(clientDescriptor);
+	}
+
+	close(listenDescriptor);
+	unlink(socketPath);
+	return false;
+}
+
+
+// Give an output stream a buffer that holds a whole host (kept until exit)...
+void hostBuffer(FILE *output)
+{
+	// Variables...
+	char *buffer = malloc(parallel_buffer);
+
+	if (buffer != NULL)
+		setvbuf(output, buffer, _IOFBF, parallel_buffer);
+}
+
+
+// Command line: a compressed output file (fopencookie() stream)...
+struct compressedOutput
+{
+	int fileDescriptor;
+	int format;
+	int level;
+	int shared;
+	char *frame;
+	size_t used;
+};
+
+
+// Command line: write a whole buffer to a descriptor...
+int writeAll(int fileDescriptor, const char *buffer, size_t size)
+{
+	// Variables...
+	ssize_t written;
+
+	while (size > 0)
+	{
+		written = write(fileDescriptor, buffer, size);
+		if ((written < 0) && (errno == EINTR))
+			continue;
+		if (written <= 0)
+			return false;
+		buffer += written;
+		size -= written;
+	}
+	return true;
+}
+
+
+// Command line: compress the buffered data as one frame and write it...
+//   Every frame is a complete gzip member / zstd frame. Concatenated
+//   they are a valid file, so processes that share the file (--parallel)
+//   can each write frames of their own.
+int compressFrame(struct compressedOutput *output)
+{
+	// Variables...
+	z_stream stream;
+	char *compressed;
+	size_t size;
+	int status;
+
+	if (output->used == 0)
+		return true;
+
+#ifdef WITH_ZSTD
+	if (output->format == compress_zstd)
+	{
+		size = ZSTD_compressBound(output->used);
+		compressed = malloc(size);
+		if (compressed == NULL)
+			return false;
+		size = ZSTD_compress(compressed, size, output->frame, output->used, output->level);
+		status = (ZSTD_isError(size) == 0) && (writeAll(output->fileDescriptor, compressed, size) == true);
+		free(compressed);
+		output->used = 0;
+		return status;
+	}
+#endif
 
-		// Disconnect from host
-		close(socketDescriptor);
+	// gzip member...
+	memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, output->level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+	size = deflateBound(&stream, output->used);
+	compressed = malloc(size);
+	status = false;
+	if (compressed != NULL)
+	{
+		stream.next_in = (unsigned char *)output->frame;
+		stream.avail_in = output->used;
+		stream.next_out = (unsigned char *)compressed;
+		stream.avail_out = size;
+		if (deflate(&stream, Z_FINISH) == Z_STREAM_END)
+			status = writeAll(output->fileDescriptor, compressed, size - stream.avail_out);
+		free(compressed);
 	}
+	deflateEnd(&stream);
+	output->used = 0;
+	return status;
+}
 
-	// Could not connect
-	else
-		status = false;
 
-	return status;
+// Command line: stdio write function of a compressed output...
+ssize_t compressedWrite(void *cookie, const char *buffer, size_t size)
+{
+	// Variables...
+	struct compressedOutput *output = cookie;
+	size_t copy;
+	size_t done = 0;
+
+	while (done < size)
+	{
+		copy = size - done;
+		if (copy > compress_frame - output->used)
+			copy = compress_frame - output->used;
+		memcpy(output->frame + output->used, buffer + done, copy);
+		output->used += copy;
+		done += copy;
+		if ((output->used == compress_frame) && (compressFrame(output) == false))
+			return -1;
+	}
+
+	// A shared file gets what was flushed at once, as a frame of its own...
+	if ((output->shared == true) && (compressFrame(output) == false))
+		return -1;
+	return size;
 }
 
-/*static int ocsp_resp_cb(SSL *ssl, void *arg)
+
+// Command line: stdio close function of a compressed output...
+int compressedClose(void *cookie)
 {
-	return(true);
-}*/
+	// Variables...
+	struct compressedOutput *output = cookie;
+	int status;
 
+	status = compressFrame(output);
+	if (close(output->fileDescriptor) != 0)
+		status = false;
+	free(output->frame);
+	free(output);
+	return (status == true) ? 0 : EOF;
+}
 
-// Get certificate...
-int getCertificate(struct sslCheckOptions *options)
+
+// Command line: open an output file, compressed if it ends in .gz or .zst...
+//   level 0 is the default level of the format. A shared file is written
+//   by several processes (--parallel), what they flush is written at once.
+FILE *openOutput(const char *fileName, int level, int shared)
 {
 	// Variables...
-	int cipherStatus = 0;
+	cookie_io_functions_t functions = { NULL, compressedWrite, NULL, compressedClose };
+	struct compressedOutput *output;
+	size_t length = strlen(fileName);
+	int format = compress_none;
+	FILE *file;
+
+	if ((length > 3) && (strcmp(fileName + length - 3, ".gz") == 0))
+		format = compress_gzip;
+	else if ((length > 4) && (strcmp(fileName + length - 4, ".zst") == 0))
+		format = compress_zstd;
+	if (format == compress_none)
+		return fopen(fileName, "w");
+#ifndef WITH_ZSTD
+	if (format == compress_zstd)
+	{
+		printf("%sERROR: This sslscan was built without zstd (WITH_ZSTD).%s\n", COL_RED, RESET);
+		return NULL;
+	}
+#endif
+
+	output = calloc(1, sizeof(struct compressedOutput));
+	if (output == NULL)
+		return NULL;
+	output->format = format;
+	output->level = level;
+	if (level == 0)
+		output->level = (format == compress_gzip) ? Z_DEFAULT_COMPRESSION : 3;
+	output->shared = shared;
+	output->frame = malloc(compress_frame);
+	output->fileDescriptor = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ((output->frame == NULL) || (output->fileDescriptor < 0))
+	{
+		if (output->fileDescriptor >= 0)
+			close(output->fileDescriptor);
+		free(output->frame);
+		free(output);
+		return NULL;
+	}
+	file = fopencookie(output, "w", functions);
+	if (file == NULL)
+		compressedClose(output);
+	return file;
+}
+
+
+// Scan the hosts of a targets file...
+//   With a shared counter (--parallel) the workers all read the file
+//   and take the next unclaimed target from the counter, so a slow
+//   host does not hold up the others. Each host is written out in one
+//   piece when it is done (see hostBuffer()).
+int scanTargets(struct sslCheckOptions *options, char *targetsPath, int *nextTarget)
+{
+	// Variables...
+	FILE *targetsFile;
+	char line[1024];
 	int status = true;
-	int socketDescriptor = 0;
-	SSL *ssl = NULL;
-	BIO *cipherConnectionBio = NULL;
-	BIO *stdoutBIO = NULL;
-	BIO *fileBIO = NULL;
-	X509 *x509Cert = NULL;
-	EVP_PKEY *publicKey = NULL;
-	const SSL_METHOD *sslMethod = NULL;
-	ASN1_OBJECT *asn1Object = NULL;
-	X509_EXTENSION *extension = NULL;
-	char buffer[1024];
-	long tempLong = 0;
-	int tempInt = 0;
-	int tempInt2 = 0;
-	long verifyError = 0;
-	int len = 0;
-	const unsigned char *raw_ocsp = NULL;
-	OCSP_RESPONSE  *ocsp_resp = NULL;
+	int target = 0;
+	int claimed = -1;
+	int tempInt;
 
-	// Connect to host
-	socketDescriptor = tcpConnect(options);
-	if (socketDescriptor != 0)
+	targetsFile = fopen(targetsPath, "r");
+	if (targetsFile == NULL)
 	{
+		printf("%sERROR: Could not open targets file %s.%s\n", COL_RED, targetsPath, RESET);
+		return false;
+	}
 
-		// Setup Context Object...
-		sslMethod = SSLv23_method();
-		options->ctx = SSL_CTX_new(sslMethod);
-		if (options->ctx != NULL)
+	readLine(targetsFile, line, sizeof(line));
+	while (feof(targetsFile) == 0)
+	{
+		if (strlen(line) != 0)
 		{
-			// set location for trusted CAs
-			if(SSL_CTX_load_verify_locations(options->ctx,options->cafile,NULL))
+			// Claimed by another worker...
+			if ((nextTarget != 0) && (claimed < target))
+				claimed = __sync_fetch_and_add(nextTarget, 1);
+			if ((nextTarget == 0) || (claimed == target))
 			{
+				// Get host...
+				tempInt = 0;
+				while ((line[tempInt] != 0) && (line[tempInt] != ':'))
+					tempInt++;
+				line[tempInt] = 0;
+				options->host = arenaString(options, line);
+
+				// Get port (if it exists)...
+				tempInt++;
+				if (strlen(line + tempInt) > 0)
+					options->port = atoi(line + tempInt);
 
-				if (SSL_CTX_set_cipher_list(options->ctx, "ALL:COMPLEMENTOFALL") != 0)
+				// Test the host...
+				status = testHost(options);
+				metricsAdd(options, queueDepth, -1);
+				if (nextTarget != 0)
 				{
+					fflush(stdout);
+					if (options->xmlOutput != 0)
+						fflush(options->xmlOutput);
+				}
+			}
+			target++;
+		}
+		readLine(targetsFile, line, sizeof(line));
+	}
+	fclose(targetsFile);
 
-					// Load Certs if required...
-					if ((options->clientCertsFile != 0) || (options->privateKeyFile != 0))
-						status = loadCerts(options);
+	return status;
+}
 
-					if (status == true)
-					{
-						// Create SSL object...
-						ssl = SSL_new(options->ctx);
-						if (ssl != NULL)
-						{
 
-							// Connect socket and BIO
-							cipherConnectionBio = BIO_new_socket(socketDescriptor, BIO_NOCLOSE);
-
-							// Connect SSL and BIO
-							SSL_set_bio(ssl, cipherConnectionBio, cipherConnectionBio);
-							
-							// set SNI Servername
-							if (options->sniEnable == true){
-								if(!SSL_set_tlsext_host_name(ssl,options->sniServername)){
-									status = false;
-									printf("%s    ERROR: Failed to set the SNI servername to %s (SSLv1-3 does not support SNI)%s\n", COL_RED,options->sniServername,RESET);
-								}
-							}
+// Scan a targets file with a number of worker processes...
+int scanTargetsParallel(struct sslCheckOptions *options, char *targetsPath, int workers)
+{
+	// Variables...
+	int *nextTarget;
+	pid_t pids[parallel_max];
+	int started;
+	int loop;
 
-							// add TLS Status reuqest (OCSP)
-							if (options->OCSPStatusRequest == true){
-								if(SSL_set_tlsext_status_type(ssl, TLSEXT_STATUSTYPE_ocsp)){
-									//SSL_CTX_set_tlsext_status_cb(options->ctx, ocsp_resp_cb);
-								}
-								else{
-									status = false;
-									printf("%s    ERROR: Failed to set TLS Status request (OCSP stapling)%s\n", COL_RED,RESET);
-								}
+	nextTarget = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (nextTarget == MAP_FAILED)
+		return scanTargets(options, targetsPath, 0);
+	*nextTarget = 0;
 
-							}
+	// Buffered output would be written by every worker...
+	fflush(stdout);
+	if (options->xmlOutput != 0)
+		fflush(options->xmlOutput);
+	if (options->traceOutput != 0)
+		fflush(options->traceOutput);
 
-							// Connect SSL over socket
-							cipherStatus = SSL_connect(ssl);
-							if (cipherStatus == 1)
-							{
+	for (started = 0; started < workers; started++)
+	{
+		pids[started] = fork();
+		if (pids[started] == 0)
+		{
+			scanTargets(options, targetsPath, nextTarget);
+			fflush(stdout);
+			if (options->xmlOutput != 0)
+				fflush(options->xmlOutput);
+			_exit(0);
+		}
+		if (pids[started] < 0)
+			break;
+	}
+	for (loop = 0; loop < started; loop++)
+		waitpid(pids[loop], NULL, 0);
+	munmap(nextTarget, sizeof(int));
 
-								// Setup BIO's
-								stdoutBIO = BIO_new(BIO_s_file());
-								BIO_set_fp(stdoutBIO, stdout, BIO_NOCLOSE);
-								if (options->xmlOutput != 0)
-								{
-									fileBIO = BIO_new(BIO_s_file());
-									BIO_set_fp(fileBIO, options->xmlOutput, BIO_NOCLOSE);
-								}
-
-								// Get Certificate...
-								printf("\n  %sSSL Certificate:%s\n", COL_BLUE, RESET);
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  <certificate>\n");
-								x509Cert = SSL_get_peer_certificate(ssl);
-								if (x509Cert != NULL)
-								{
-
-									//SSL_set_verify(ssl, SSL_VERIFY_NONE|SSL_VERIFY_CLIENT_ONCE, NULL);
-
-									// Cert Version
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_VERSION))
-									{
-										tempLong = X509_get_version(x509Cert);
-										printf("    Version: %lu (0x%lx)\n", tempLong+1, tempLong);
-										if (options->xmlOutput != 0)
-											fprintf(options->xmlOutput, "   <version>%lu</version>\n", tempLong);
-									}
-
-									// Cert Serial No.
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_SERIAL))
-									{
-										ASN1_INTEGER *asn1_serial= NULL;
-										asn1_serial= X509_get_serialNumber(x509Cert);
-										if(asn1_serial == NULL){
-											printf("%s    ERROR: X509_get_serialNumber() failed to get serial from certificate.%s\n", COL_RED, RESET);
-										}else{
-											char *neg;
-											int i= 0;
-											neg=(asn1_serial->type == V_ASN1_NEG_INTEGER)?"(Negative)":"";
-											printf("    Serial Number: %s",neg);
-											if (options->xmlOutput != 0)
-												fprintf(options->xmlOutput, "   <serial>");
-											for (i= 0; i<asn1_serial->length; i++) {
-												printf("%02x%c",asn1_serial->data[i],
-												((i+1 == asn1_serial->length)?'\n':':'));
-												if (options->xmlOutput != 0)
-													fprintf(options->xmlOutput, "%02x%c",asn1_serial->data[i],
-													((i+1 == asn1_serial->length)?'<':':'));
-											}
-											if (options->xmlOutput != 0)
-												fprintf(options->xmlOutput, "/serial>\n");
-										}
-									}
-
-									// Signature Algo...
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_SIGNAME))
-									{
-										printf("    Signature Algorithm: ");
-										i2a_ASN1_OBJECT(stdoutBIO, x509Cert->cert_info->signature->algorithm);
-										printf("\n");
-										if (options->xmlOutput != 0)
-										{
-											fprintf(options->xmlOutput, "   <signature-algorithm>");
-											i2a_ASN1_OBJECT(fileBIO, x509Cert->cert_info->signature->algorithm);
-											fprintf(options->xmlOutput, "</signature-algorithm>\n");
-										}
-									}
-
-									// SSL Certificate Issuer...
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_ISSUER))
-									{
-										X509_NAME_oneline(X509_get_issuer_name(x509Cert), buffer, sizeof(buffer) - 1);
-										printf("    Issuer: %s\n", buffer);
-										if (options->xmlOutput != 0)
-											fprintf(options->xmlOutput, "   <issuer>%s</issuer>\n", buffer);
-									}
-
-									// Validity...
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_VALIDITY))
-									{
-										printf("    Not valid before: ");
-										ASN1_TIME_print(stdoutBIO, X509_get_notBefore(x509Cert));
-										if (options->xmlOutput != 0)
-										{
-											fprintf(options->xmlOutput, "   <not-valid-before>");
-											ASN1_TIME_print(fileBIO, X509_get_notBefore(x509Cert));
-											fprintf(options->xmlOutput, "</not-valid-before>\n");
-										}
-										printf("\n    Not valid after: ");
-										ASN1_TIME_print(stdoutBIO, X509_get_notAfter(x509Cert));
-										printf("\n");
-										if (options->xmlOutput != 0)
-										{
-											fprintf(options->xmlOutput, "   <not-valid-after>");
-											ASN1_TIME_print(fileBIO, X509_get_notAfter(x509Cert));
-											fprintf(options->xmlOutput, "</not-valid-after>\n");
-										}
-									}
-
-									// SSL Certificate Subject...
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_SUBJECT))
-									{
-										X509_NAME_oneline(X509_get_subject_name(x509Cert), buffer, sizeof(buffer) - 1);
-										printf("    Subject: %s\n", buffer);
-										if (options->xmlOutput != 0)
-											fprintf(options->xmlOutput, "   <subject>%s</subject>\n", buffer);
-									}
-
-									// Public Key Algo...
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_PUBKEY))
-									{
-										printf("    Public Key Algorithm: ");
-										i2a_ASN1_OBJECT(stdoutBIO, x509Cert->cert_info->key->algor->algorithm);
-										printf("\n");
-										if (options->xmlOutput != 0)
-										{
-											fprintf(options->xmlOutput, "   <pk-algorithm>");
-											i2a_ASN1_OBJECT(fileBIO, x509Cert->cert_info->key->algor->algorithm);
-											fprintf(options->xmlOutput, "</pk-algorithm>\n");
-										}
-
-										// Public Key...
-										publicKey = X509_get_pubkey(x509Cert);
-										if (publicKey == NULL)
-										{
-											printf("    Public Key: Could not load\n");
-											if (options->xmlOutput != 0)
-												fprintf(options->xmlOutput, "   <pk error=\"true\" />\n");
-										}
-										else
-										{
-											switch (publicKey->type)
-											{
-												case EVP_PKEY_RSA:
-													printf("    RSA Public Key: (%d bit)\n", BN_num_bits(publicKey->pkey.rsa->n));
-													if (options->xmlOutput != 0)
-														fprintf(options->xmlOutput, "   <pk error=\"false\" type=\"RSA\" bits=\"%d\">\n", BN_num_bits(publicKey->pkey.rsa->n));
-													RSA_print(stdoutBIO, publicKey->pkey.rsa, 6);
-													if (options->xmlOutput != 0)
-													{
-														RSA_print(fileBIO, publicKey->pkey.rsa, 4);
-														fprintf(options->xmlOutput, "   </pk>\n");
-													}
-													break;
-												case EVP_PKEY_DSA:
-													printf("    DSA Public Key:\n");
-													if (options->xmlOutput != 0)
-														fprintf(options->xmlOutput, "   <pk error=\"false\" type=\"DSA\">\n");
-													DSA_print(stdoutBIO, publicKey->pkey.dsa, 6);
-													if (options->xmlOutput != 0)
-													{
-														DSA_print(fileBIO, publicKey->pkey.dsa, 4);
-														fprintf(options->xmlOutput, "   </pk>\n");
-													}
-													break;
-												#ifdef OPENSSL_WITH_EC
-												case EVP_PKEY_EC:
-													printf("    EC Public Key:\n");
-													if (options->xmlOutput != 0)
-														fprintf(options->xmlOutput, "   <pk error=\"false\" type=\"EC\">\n");
-													EC_KEY_print(stdoutBIO, publicKey->pkey.ec, 6);
-													if (options->xmlOutput != 0)
-													{
-														EC_KEY_print(fileBIO, publicKey->pkey.ec, 4);
-														fprintf(options->xmlOutput, "   </pk>\n");
-													}
-													break;
-												#endif
-												default:
-													printf("    Public Key: Unknown\n");
-													if (options->xmlOutput != 0)
-														fprintf(options->xmlOutput, "   <pk error=\"true\" type=\"unknown\" />\n");
-													break;
-											}
-
-											EVP_PKEY_free(publicKey);
-										}
-									}
-
-									// X509 v3...
-									if (!(X509_FLAG_COMPAT & X509_FLAG_NO_EXTENSIONS))
-									{
-										if (sk_X509_EXTENSION_num(x509Cert->cert_info->extensions) > 0)
-										{
-											printf("    X509v3 Extensions:\n");
-											if (options->xmlOutput != 0)
-												fprintf(options->xmlOutput, "   <X509v3-Extensions>\n");
-											for (tempInt = 0; tempInt < sk_X509_EXTENSION_num(x509Cert->cert_info->extensions); tempInt++)
-											{
-												// Get Extension...
-												extension = sk_X509_EXTENSION_value(x509Cert->cert_info->extensions, tempInt);
-
-												// Print Extension name...
-												printf("      ");
-												asn1Object = X509_EXTENSION_get_object(extension);
-												i2a_ASN1_OBJECT(stdoutBIO, asn1Object);
-												tempInt2 = X509_EXTENSION_get_critical(extension);
-												BIO_printf(stdoutBIO, ": %s\n", tempInt2 ? "critical" : "");
-												if (options->xmlOutput != 0)
-												{
-													fprintf(options->xmlOutput, "    <extension name=\"");
-													i2a_ASN1_OBJECT(fileBIO, asn1Object);
-													BIO_printf(fileBIO, "\"%s>", tempInt2 ? " level=\"critical\"" : "");
-												}
-
-												// Print Extension value...
-												if (!X509V3_EXT_print(stdoutBIO, extension, X509_FLAG_COMPAT, 8))
-												{
-													printf("        ");
-													M_ASN1_OCTET_STRING_print(stdoutBIO, extension->value);
-												}
-												if (options->xmlOutput != 0)
-												{
-													if (!X509V3_EXT_print(fileBIO, extension, X509_FLAG_COMPAT, 0))
-														M_ASN1_OCTET_STRING_print(fileBIO, extension->value);
-													fprintf(options->xmlOutput, "</extension>\n");
-												}
-												printf("\n");
-											}
-											if (options->xmlOutput != 0)
-												fprintf(options->xmlOutput, "   </X509v3-Extensions>\n");
-										}
-									}
-
-									// Verify Certificate...
-									printf("  Verify Certificate:\n");
-									verifyError = SSL_get_verify_result(ssl);
-									if (verifyError == X509_V_OK)
-										printf("    Certificate passed verification\n");
-									else
-										printf("    %s\n", X509_verify_cert_error_string(verifyError));
-
-									// Free X509 Certificate...
-									X509_free(x509Cert);
-								}
-
-
-								// Show OCSP Ticket
-								if (options->OCSPStatusRequest == true){
-									printf("\n  %sCertificate Status Request (OCSP Stapling):%s\n", COL_BLUE, RESET);
-									// get the OCSP response
-									len= SSL_get_tlsext_status_ocsp_resp(ssl,&raw_ocsp);
-									if(!raw_ocsp){
-										printf("Certificate Status Request sent but no OCSP ticket stapled in response.\n");
-										return(1); // TODO return somenthing useful
-									}
-									// try to parse the OCSP response
-									ocsp_resp= d2i_OCSP_RESPONSE(NULL,&raw_ocsp,len);
-									if(!ocsp_resp){
-										printf("failed to parse OCSP response :( \n");
-										return(1);
-									}
-									// print/dump the response to the screen
-									OCSP_RESPONSE_print(stdoutBIO,ocsp_resp,0);
-								}
-								
-
-								if (options->xmlOutput != 0)
-									fprintf(options->xmlOutput, "  </certificate>\n");
-
-								// Free BIO
-								BIO_free(stdoutBIO);
-								if (options->xmlOutput != 0)
-									BIO_free(fileBIO);
-
-								// Disconnect SSL over socket
-								SSL_shutdown(ssl);
-							}
+	return (started > 0);
+}
 
-							// Free SSL object
-							SSL_free(ssl);
-						}
-						else
-						{
-							status = false;
-							printf("%s    ERROR: Could create SSL object.%s\n", COL_RED, RESET);
-						}
-					}
-				}
-				else
-				{
-					status = false;
-					printf("%s    ERROR: Could set cipher.%s\n", COL_RED, RESET);
-				}
-			}
-			else
-			{
-				status = false;
-				printf("%s    ERROR: failed to load trusted CA file:%s.%s\n", COL_RED,options->cafile, RESET);
-			}
 
-			// Free CTX Object
-			SSL_CTX_free(options->ctx);
-		}
+// Load test: outcomes of the handshakes of a cipher, shared by the workers...
+struct loadCounters
+{
+	long attempted;
+	long accepted;
+	long rejected;
+	long failures[failure_network + 1];
+	long samples;
+	long long sample[loadtest_samples_max];
+};
 
-		// Error Creating Context Object
-		else
+
+// Load test: drive full handshakes of a cipher until the end...
+//   With a rate the handshakes of a worker are paced, a worker that falls
+//   behind (the server is saturated) does not catch up in a burst.
+//   Retries are off, every failed handshake counts.
+void loadWorker(struct sslCheckOptions *options, SSL_CTX *ctx, const struct sslCipher *sslCipherPointer, struct loadCounters *counters, long long next, long long end, long long interval)
+{
+	// Variables...
+	struct sslCipherResult result;
+	char buffer[50];
+	long long now;
+	long index;
+
+	options->retryBudget = 0;
+	options->callbacks.error = 0;
+	while ((now = timeMicroseconds()) < end)
+	{
+		if ((interval > 0) && (now < next))
 		{
-			status = false;
-			printf("%sERROR: Could not create CTX object.%s\n", COL_RED, RESET);
+			usleep(next - now);
+			if (timeMicroseconds() >= end)
+				break;
 		}
+		else if ((interval > 0) && (now > next + interval))
+			next = now;
+		next += interval;
 
-		// Disconnect from host
-		close(socketDescriptor);
+		cipherProbe(options, ctx, sslCipherPointer, &result, buffer);
+		__sync_fetch_and_add(&counters->attempted, 1);
+		if (result.status == probe_accepted)
+		{
+			__sync_fetch_and_add(&counters->accepted, 1);
+			index = __sync_fetch_and_add(&counters->samples, 1);
+			if (index < loadtest_samples_max)
+				counters->sample[index] = result.handshakeTime;
+		}
+		else if (result.status == probe_rejected)
+			__sync_fetch_and_add(&counters->rejected, 1);
+		else
+			__sync_fetch_and_add(&counters->failures[(result.failure <= failure_network) ? result.failure : failure_local], 1);
 	}
+}
 
-	// Could not connect
-	else
-		status = false;
 
-	return status;
+// Load test: order of the handshake latencies...
+int loadSampleCompare(const void *first, const void *second)
+{
+	long long difference = *(const long long *)first - *(const long long *)second;
+
+	return (difference > 0) - (difference < 0);
 }
 
 
-// Test a single host and port for ciphers...
-int testHost(struct sslCheckOptions *options)
+// Load test: a latency percentile in milliseconds...
+double loadPercentile(struct loadCounters *counters, long samples, int percent)
+{
+	if (samples == 0)
+		return 0.0;
+	return counters->sample[(samples - 1) * percent / 100] / 1000.0;
+}
+
+
+// Load test of the accepted ciphers of the host (--loadtest)...
+//   Every cipher gets its own run: connections worker processes make full
+//   handshakes (no session is resumed) for seconds, at rate handshakes per
+//   second in total (0 for as many as the server completes). The server
+//   handshakes per second, the latency percentiles of the handshakes and
+//   the errors are printed per cipher.
+int loadTest(struct sslCheckOptions *options, int seconds, int connections, int rate)
 {
 	// Variables...
-	struct sslCipher *sslCipherPointer;
-	int status = true;
+	struct loadCounters *counters;
+	struct sslCipher sslCipher;
+	pid_t pids[parallel_max];
+	SSL_CTX *ctx;
+	long long start;
+	long long elapsed;
+	long long interval;
+	long samples;
+	long errors;
+	int started = 0;
+	int cipher;
+	int loop;
 
-	// Resolve Host Name
-	options->hostStruct = gethostbyname(options->host);
-	if (options->hostStruct == NULL)
+	if (loadCipherCount == 0)
 	{
-		printf("%sERROR: Could not resolve hostname %s.%s\n", COL_RED, options->host, RESET);
+		printf("%sERROR: No accepted cipher to load test on %s.%s\n", COL_RED, options->host, RESET);
+		return false;
+	}
+	counters = mmap(NULL, sizeof(struct loadCounters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (counters == MAP_FAILED)
+	{
+		printf("%sERROR: Could not allocate the load test counters.%s\n", COL_RED, RESET);
 		return false;
 	}
 
-	// Configure Server Address and Port
-	options->serverAddress.sin_family = options->hostStruct->h_addrtype;
-	memcpy((char *) &options->serverAddress.sin_addr.s_addr, options->hostStruct->h_addr_list[0], options->hostStruct->h_length);
-	options->serverAddress.sin_port = htons(options->port);
-
-	// XML Output...
-	if (options->xmlOutput != 0)
-		fprintf(options->xmlOutput, " <ssltest host=\"%s\" port=\"%d\">\n", options->host, options->port);
+	printf("\n  %sHandshake Load Test (%d connections, ", COL_BLUE, connections);
+	if (rate > 0)
+		printf("%d handshakes/s, ", rate);
+	printf("%d s per cipher):%s\n", seconds, RESET);
+	if (options->pout == true)
+		printf("|| Version || Bits || Cipher || Handshakes/s || p50 ms || p90 ms || p99 ms || Max ms || Errors ||\n");
+	fflush(stdout);
 
-	// Test supported ciphers...
-	printf("\n%sTesting SSL server %s on port %d%s\n\n", COL_GREEN, options->host, options->port, RESET);
-	printf("  %sSupported Server Cipher(s):%s\n", COL_BLUE, RESET);
-	if ((options->http == true) && (options->pout == true))
-		printf("|| Status || HTTP Code || Version || Bits || Cipher ||\n");
-	else if (options->pout == true)
-		printf("|| Status || Version || Bits || Cipher ||\n");
-	sslCipherPointer = options->ciphers;
-	while ((sslCipherPointer != 0) && (status == true))
+	interval = (rate > 0) ? (long long)connections * 1000000 / rate : 0;
+	for (cipher = 0; cipher < loadCipherCount; cipher++)
 	{
+		memset(&sslCipher, 0, sizeof(sslCipher));
+		sslCipher.name = loadCiphers[cipher].name;
+		sslCipher.sslVersion = loadCiphers[cipher].sslVersion;
+		sslCipher.version = sslVersionName(sslCipher.sslVersion);
+		sslCipher.bits = loadCiphers[cipher].bits;
+		sslCipher.sslMethod = sslVersionMethod(sslCipher.sslVersion);
+		ctx = getContext(options, sslCipher.sslMethod, false);
+		if (ctx == NULL)
+		{
+			printf("%sERROR: Could not create CTX object.%s\n", COL_RED, RESET);
+			continue;
+		}
 
-		// Setup Context Object...
-		options->ctx = SSL_CTX_new(sslCipherPointer->sslMethod);
-		if (options->ctx != NULL)
+		// The workers share the context of the parent...
+		memset(counters, 0, sizeof(struct loadCounters));
+		start = timeMicroseconds();
+		for (started = 0; started < connections; started++)
 		{
+			pids[started] = fork();
+			if (pids[started] == 0)
+			{
+				loadWorker(options, ctx, &sslCipher, counters, start + interval * started / connections, start + seconds * 1000000LL, interval);
+				_exit(0);
+			}
+			if (pids[started] < 0)
+				break;
+		}
+		for (loop = 0; loop < started; loop++)
+			waitpid(pids[loop], NULL, 0);
+		elapsed = timeMicroseconds() - start;
 
-			// SSL implementation bugs/workaround
-			if (options->sslbugs)
-				SSL_CTX_set_options(options->ctx, SSL_OP_ALL | 0);
+		// Percentiles of the handshakes that were kept...
+		samples = (counters->samples < loadtest_samples_max) ? counters->samples : loadtest_samples_max;
+		qsort(counters->sample, samples, sizeof(long long), loadSampleCompare);
+		errors = counters->attempted - counters->accepted;
+
+		if (options->pout == true)
+			printf("|| %s || %d || %s || %.1f || %.2f || %.2f || %.2f || %.2f || %.1f%% ||\n", sslCipher.version, sslCipher.bits, sslCipher.name,
+				counters->accepted * 1000000.0 / elapsed, loadPercentile(counters, samples, 50), loadPercentile(counters, samples, 90),
+				loadPercentile(counters, samples, 99), loadPercentile(counters, samples, 100), (counters->attempted > 0) ? errors * 100.0 / counters->attempted : 0.0);
+		else
+		{
+			printf("    %-7s  %4d bits  %-29s %8.1f/s  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms  ", sslCipher.version, sslCipher.bits, sslCipher.name,
+				counters->accepted * 1000000.0 / elapsed, loadPercentile(counters, samples, 50), loadPercentile(counters, samples, 90),
+				loadPercentile(counters, samples, 99), loadPercentile(counters, samples, 100));
+			if (errors == 0)
+				printf("errors 0\n");
 			else
-				SSL_CTX_set_options(options->ctx, 0);
+			{
+				printf("%serrors %ld (%.1f%%):", COL_RED, errors, errors * 100.0 / counters->attempted);
+				if (counters->rejected > 0)
+					printf(" rejected=%ld", counters->rejected);
+				for (loop = failure_timeout; loop <= failure_network; loop++)
+				{
+					if (counters->failures[loop] > 0)
+						printf(" %s=%ld", failureNames[loop], counters->failures[loop]);
+				}
+				printf("%s\n", RESET);
+			}
+		}
+		fflush(stdout);
+	}
 
-			// Load Certs if required...
-			if ((options->clientCertsFile != 0) || (options->privateKeyFile != 0))
-				status = loadCerts(options);
+	munmap(counters, sizeof(struct loadCounters));
+	return (started > 0);
+}
 
-			// Test
-			if (status == true)
-				status = testCipher(options, sslCipherPointer);
 
-			// Free CTX Object
-			SSL_CTX_free(options->ctx);
-		}
-	
-		// Error Creating Context Object
-		else
+// Sweep a batch of targets, write out those that answered with TLS...
+//   Targets that could not be resolved are written out too, the scan
+//   reports them. If the sweep cannot be run every target is written.
+void sweepBatch(struct sslCheckOptions *options, char *hosts, int *ports, struct sockaddr_in *addresses, int count, FILE *sweptFile)
+{
+	// Variables...
+	char *answered = malloc(count);
+	int swept;
+	int loop;
+
+	swept = (answered != NULL) && (sslScanSweep(options, addresses, count, answered) == true);
+	for (loop = 0; loop < count; loop++)
+	{
+		if ((swept == false) || (answered[loop] == true) || (addresses[loop].sin_family != AF_INET))
 		{
-			status = false;
-			printf("%sERROR: Could not create CTX object.%s\n", COL_RED, RESET);
+			fprintf(sweptFile, "%s:%d\n", hosts + loop * BUFFERSIZE, ports[loop]);
+			continue;
 		}
 
-		sslCipherPointer = sslCipherPointer->next;
+		// No TLS answer, reported as a failed host...
+		options->host = arenaString(options, hosts + loop * BUFFERSIZE);
+		options->port = ports[loop];
+		if (options->callbacks.hostStart != 0)
+			options->callbacks.hostStart(options->userData, options->host, options->port);
+		scanError(options, "    ERROR: No TLS answer from %s on port %d.", options->host, options->port);
+		if (options->callbacks.hostEnd != 0)
+			options->callbacks.hostEnd(options->userData, options->host, options->port, false);
+		metricsAdd(options, queueDepth, -1);
+		arenaRelease(options);
 	}
+	free(answered);
+}
 
-	if (status == true)
+
+// Sweep the targets file in batches of width endpoints...
+//   The targets that answered are written to sweptPath (a mkstemp()
+//   template), which is then scanned instead of the targets file.
+int sweepTargets(struct sslCheckOptions *options, char *targetsPath, int width, char *sweptPath)
+{
+	// Variables...
+	struct sockaddr_in *addresses;
+	struct addrinfo hints;
+	struct addrinfo *addressInfo;
+	FILE *targetsFile;
+	FILE *sweptFile;
+	char line[BUFFERSIZE];
+	char *hosts;
+	int *ports;
+	int defaultPort = options->port;
+	int sweptDescriptor;
+	int count = 0;
+	int tempInt;
+
+	targetsFile = fopen(targetsPath, "r");
+	if (targetsFile == NULL)
 	{
-		// Test prefered ciphers...
-		printf("\n  %sPrefered Server Cipher(s):%s\n", COL_BLUE, RESET);
-		if (options->pout == true)
-			printf("|| Version || Bits || Cipher ||\n");
-		status= true;
-#ifndef DISABLE_SSLv2
-		if((options->sslVersion & ssl_v2) && (status != false)) status = defaultCipher(options, SSLv2_client_method()); 
-#endif
-		if((options->sslVersion & ssl_v3) && (status != false)) status = defaultCipher(options, SSLv3_client_method());
-		if((options->sslVersion & tls_v1) && (status != false)) status = defaultCipher(options, TLSv1_client_method());
-		if((options->sslVersion & tls_v1_1) && (status != false)) status = defaultCipher(options, TLSv1_1_client_method());
-		if((options->sslVersion & tls_v1_2) && (status != false)) status = defaultCipher(options, TLSv1_2_client_method());
+		printf("%sERROR: Could not open targets file %s.%s\n", COL_RED, targetsPath, RESET);
+		return false;
 	}
-
-	if (status == true)
+	sweptDescriptor = mkstemp(sweptPath);
+	sweptFile = (sweptDescriptor < 0) ? NULL : fdopen(sweptDescriptor, "w");
+	hosts = malloc(width * BUFFERSIZE);
+	ports = malloc(width * sizeof(int));
+	addresses = malloc(width * sizeof(struct sockaddr_in));
+	if ((sweptFile == NULL) || (hosts == NULL) || (ports == NULL) || (addresses == NULL))
 	{
-		status = getCertificate(options);
+		printf("%sERROR: Could not create the sweep file %s.%s\n", COL_RED, sweptPath, RESET);
+		if (sweptFile != NULL)
+			fclose(sweptFile);
+		if (sweptDescriptor >= 0)
+			unlink(sweptPath);
+		free(hosts);
+		free(ports);
+		free(addresses);
+		fclose(targetsFile);
+		return false;
 	}
 
-	// XML Output...
-	if (options->xmlOutput != 0)
-		fprintf(options->xmlOutput, " </ssltest>\n");
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	readLine(targetsFile, line, sizeof(line));
+	while (feof(targetsFile) == 0)
+	{
+		if (strlen(line) != 0)
+		{
+			// Get host and port...
+			tempInt = 0;
+			while ((line[tempInt] != 0) && (line[tempInt] != ':'))
+				tempInt++;
+			ports[count] = defaultPort;
+			if ((line[tempInt] == ':') && (strlen(line + tempInt + 1) > 0))
+				ports[count] = atoi(line + tempInt + 1);
+			line[tempInt] = 0;
+			strcpy(hosts + count * BUFFERSIZE, line);
+
+			// Resolve...
+			memset(&addresses[count], 0, sizeof(struct sockaddr_in));
+			if (getaddrinfo(line, NULL, &hints, &addressInfo) == 0)
+			{
+				memcpy(&addresses[count], addressInfo->ai_addr, sizeof(struct sockaddr_in));
+				addresses[count].sin_port = htons(ports[count]);
+				freeaddrinfo(addressInfo);
+			}
 
-	// Return status...
-	return status;
+			count++;
+			if (count == width)
+			{
+				sweepBatch(options, hosts, ports, addresses, count, sweptFile);
+				count = 0;
+			}
+		}
+		readLine(targetsFile, line, sizeof(line));
+	}
+	if (count > 0)
+		sweepBatch(options, hosts, ports, addresses, count, sweptFile);
+
+	fclose(targetsFile);
+	fclose(sweptFile);
+	free(hosts);
+	free(ports);
+	free(addresses);
+	options->port = defaultPort;
+	return true;
 }
 
 
@@ -1556,22 +7487,40 @@ int main(int argc, char *argv[])
 {
 	// Variables...
 	struct sslCheckOptions options;
-	struct sslCipher *sslCipherPointer;
 	int status;
 	int argLoop;
 	int tempInt;
 	int maxSize;
 	int xmlArg;
+	int traceArg;
+	int daemonArg;
 	int mode = mode_help;
+	int workers = 1;
+	int sweepWidth = 0;
+	int compressLevel = 0;
+	int baselineArg = 0;
+	int loadConnections = loadtest_connections;
+	int loadRate = 0;
+	char sweptPath[] = "/tmp/sslscan-sweep-XXXXXX";
+	char *targetsPath;
+	struct rlimit fileLimit;
 	FILE *targetsFile;
 	char line[1024];
+	char *metricsListen = 0;
+	char *metricsFile = 0;
+	int metricsInterval = 10;
+	pid_t metricsPid = 0;
 
 	// Init...
 	memset(&options, 0, sizeof(struct sslCheckOptions));
 	options.port = 443;
 	xmlArg = 0;
-	strcpy(options.host, "");
-	strcpy(options.cafile,"/etc/ssl/certs/ca-certificates.crt");
+	traceArg = 0;
+	daemonArg = 0;
+	options.host = "";
+	options.cafile = default_cafile;
+	options.capath = "";
+	options.sniServername = "";
 	options.noFailed = false;
 	options.esmtps = false;
 	options.pop3s = false;
@@ -1581,7 +7530,8 @@ int main(int argc, char *argv[])
 	options.sslVersion = ssl_none;
 	options.pout = false;
 	options.OCSPStatusRequest = false;
-	SSL_library_init();
+	sslScanSetCallbacks(&options, &printCallbacks, &options);
+	sslScanInit();
 
 	// Get program parameters
 	for (argLoop = 1; argLoop < argc; argLoop++)
@@ -1597,10 +7547,6 @@ int main(int argc, char *argv[])
 			options.targets = argLoop;
 		}
 
-		// Show only supported
-		else if ((strcmp("--no-failed", argv[argLoop]) == 0) || (strcmp("-n", argv[argLoop]) == 0))
-			options.noFailed = true;
-
 		// Version
 		else if (strcmp("--version", argv[argLoop]) == 0)
 			mode = mode_version;
@@ -1609,119 +7555,102 @@ int main(int argc, char *argv[])
 		else if (strncmp("--xml=", argv[argLoop], 6) == 0)
 			xmlArg = argLoop;
 
-		// Trsuted CA file
-		else if (strncmp("--cafile=", argv[argLoop],9) == 0)
-			strncpy(options.cafile,argv[argLoop]+9,sizeof(options.cafile) -1);
-
-		// P Output
-		else if (strcmp("-p", argv[argLoop]) == 0)
-			options.pout = true;
-
-		// Client Certificates
-		else if (strncmp("--certs=", argv[argLoop], 8) == 0)
-			options.clientCertsFile = argv[argLoop] +8;
+		// No text output
+		else if ((strcmp("--quiet", argv[argLoop]) == 0) || (strcmp("-q", argv[argLoop]) == 0))
+			options.quiet = true;
 
-		// Private Key File
-		else if (strncmp("--pk=", argv[argLoop], 5) == 0)
-			options.privateKeyFile = argv[argLoop] +5;
+		// Counting-only output
+		else if (strcmp("--count", argv[argLoop]) == 0)
+			options.count = true;
 
-		// Private Key Password
-		else if (strncmp("--pkpass=", argv[argLoop], 9) == 0)
-			options.privateKeyPassword = argv[argLoop] +9;
-
-		// ESMTPS, SMTP with STARTTLS
-		else if ((strcmp("--esmtps", argv[argLoop]) == 0) || (strcmp("--starttls", argv[argLoop]) == 0))
+		// Parallel targets
+		else if ((strncmp("--parallel=", argv[argLoop], 11) == 0) && (atoi(argv[argLoop] + 11) > 0))
 		{
-			options.esmtps = true;
-			options.port = 25;
+			workers = atoi(argv[argLoop] + 11);
+			if (workers > parallel_max)
+				workers = parallel_max;
 		}
 
-		// FTPS / FTP over SSL
-		else if (strcmp("--ftps", argv[argLoop]) == 0)
+		// Reachability sweep of the targets
+		else if ((strncmp("--sweep=", argv[argLoop], 8) == 0) && (atoi(argv[argLoop] + 8) > 0))
 		{
-			options.ftps = true;
-			options.port = 21;
+			sweepWidth = atoi(argv[argLoop] + 8);
+			if (sweepWidth > sweep_width_max)
+				sweepWidth = sweep_width_max;
 		}
 
-		// FTPS / FTP over SSL check for Data Connection Sercurity: Private
-		else if (strcmp("--ftps-dcs", argv[argLoop]) == 0)
-		{
-			options.ftps = true;
-			options.ftps_dcs = true;
-			options.port = 21;
-		}
+		// Handshake load test of the accepted ciphers
+		else if ((strncmp("--loadtest=", argv[argLoop], 11) == 0) && (atoi(argv[argLoop] + 11) > 0))
+			loadSeconds = atoi(argv[argLoop] + 11);
 
-		// POP3S / STLS for pop3
-		else if (strcmp("--pop3s", argv[argLoop]) == 0)
+		// Load test connections
+		else if ((strncmp("--load-connections=", argv[argLoop], 19) == 0) && (atoi(argv[argLoop] + 19) > 0))
 		{
-			options.pop3s = true;
-			options.port = 110;
+			loadConnections = atoi(argv[argLoop] + 19);
+			if (loadConnections > parallel_max)
+				loadConnections = parallel_max;
 		}
 
-		// IMAPS / SARTTLS for imap
-		else if (strcmp("--imaps", argv[argLoop]) == 0)
-		{
-			options.imaps = true;
-			options.port = 143;
-		}
-		
-		// SSL v2
-		else if (strcmp("--ssl2", argv[argLoop]) == 0)
-			options.sslVersion |= ssl_v2;
+		// Load test rate
+		else if ((strncmp("--load-rate=", argv[argLoop], 12) == 0) && (atoi(argv[argLoop] + 12) > 0))
+			loadRate = atoi(argv[argLoop] + 12);
 
-		// SSL v3
-		else if (strcmp("--ssl3", argv[argLoop]) == 0)
-			options.sslVersion |= ssl_v3;
+		// Trace Output
+		else if (strncmp("--trace=", argv[argLoop], 8) == 0)
+			traceArg = argLoop;
 
-		// TLS v1
-		else if (strcmp("--tls1", argv[argLoop]) == 0)
-			options.sslVersion |= tls_v1;
+		// Report only the changes to a baseline
+		else if ((strncmp("--baseline=", argv[argLoop], 11) == 0) && (strlen(argv[argLoop]) > 11))
+			baselineArg = argLoop;
 
-		// TLS v1.1
-		else if (strcmp("--tls1_1", argv[argLoop]) == 0)
-			options.sslVersion |= tls_v1_1;
+		// Compression level of .gz / .zst output files
+		else if ((strncmp("--compress-level=", argv[argLoop], 17) == 0) && (atoi(argv[argLoop] + 17) > 0))
+			compressLevel = atoi(argv[argLoop] + 17);
 
-		// TLS v1.2
-		else if (strcmp("--tls1_2", argv[argLoop]) == 0)
-			options.sslVersion |= tls_v1_2;
+		// Trusted CA file, client certificates and private key
+		else if (parseIdentityOption(&options, argv[argLoop]) == true)
+			continue;
 
-		// all SSL & TLS protocols
-		else if ((strcmp("--all", argv[argLoop]) == 0) || (strcmp("-a", argv[argLoop]) == 0))
-			options.sslVersion |= ssl_tls_all;
+		// Source addresses and abortive close
+		else if ((strncmp("--source=", argv[argLoop], 9) == 0) || (strcmp("--abortive-close", argv[argLoop]) == 0))
+		{
+			if (parseConnectionOption(&options, argv[argLoop]) == false)
+				exit(0);
+		}
 
-		// all SSL protocols
-		else if (strcmp("--ssl", argv[argLoop]) == 0)
-			options.sslVersion |= ssl_all;
+		// Cipher class policy
+		else if (strncmp("--policy=", argv[argLoop], 9) == 0)
+		{
+			if (loadPolicy(&options, argv[argLoop] + 9) == false)
+				exit(0);
+		}
 
-		// all TLS protocols
-		else if (strcmp("--tls", argv[argLoop]) == 0)
-			options.sslVersion |= tls_all;
+		// Metrics HTTP endpoint
+		else if ((strncmp("--metrics=", argv[argLoop], 10) == 0) && (strlen(argv[argLoop]) > 10))
+			metricsListen = argv[argLoop] + 10;
 
-		// SSL Bugs...
-		else if (strcmp("--bugs", argv[argLoop]) == 0)
-			options.sslbugs = 1;
+		// Metrics file
+		else if ((strncmp("--metrics-file=", argv[argLoop], 15) == 0) && (strlen(argv[argLoop]) > 15))
+			metricsFile = argv[argLoop] + 15;
 
-		// SNI with a specific Servername
-		else if (strncmp("--sni=", argv[argLoop], 6) == 0)
+		// Metrics file interval
+		else if (strncmp("--metrics-interval=", argv[argLoop], 19) == 0)
 		{
-			options.sniEnable = 1;
-			strncpy(options.sniServername,argv[argLoop]+6,sizeof(options.sniServername) -1);
+			metricsInterval = atoi(argv[argLoop] + 19);
+			if (metricsInterval < 1)
+				metricsInterval = 1;
 		}
-		
-		// SNI, reuse the Hostname provided 
-		else if (strncmp("--sni", argv[argLoop], 5) == 0)
+
+		// Daemon mode
+		else if ((strncmp("--daemon=", argv[argLoop], 9) == 0) && (strlen(argv[argLoop]) > 9))
 		{
-			options.sniEnable = 1;
+			mode = mode_daemon;
+			daemonArg = argLoop;
 		}
-		
-		// TLS Certificate Status Request 
-		else if (((strcmp("--status-request", argv[argLoop]) == 0) ||  (strcmp("--ocsp-stapling", argv[argLoop]) == 0)) || (strcmp("-o", argv[argLoop]) == 0))
-			options.OCSPStatusRequest = 1;
 
-
-		// SSL HTTP Get...
-		else if (strcmp("--http", argv[argLoop]) == 0)
-			options.http = 1;
+		// Scan options...
+		else if (parseScanOption(&options, argv[argLoop]) == true)
+			continue;
 
 		// Host or anything else...
 		else
@@ -1735,7 +7664,7 @@ int main(int argc, char *argv[])
 				while ((argv[argLoop][tempInt] != 0) && (argv[argLoop][tempInt] != ':'))
 					tempInt++;
 				argv[argLoop][tempInt] = 0;
-				strncpy(options.host, argv[argLoop], sizeof(options.host) -1);
+				options.host = arenaString(&options, argv[argLoop]);
 
 				// Get port (if it exists)...
 				tempInt++;
@@ -1749,23 +7678,52 @@ int main(int argc, char *argv[])
 	}
 	// SNI requested with no specific Servername. Use the Hostname.
 	if((options.sniEnable == 1) && (sizeof(options.sniServername == 0))){
-		strncpy(options.sniServername,options.host, sizeof(options.host) -1);
+		options.sniServername = options.host;
+	}
+
+	// The load test drives one host...
+	if ((loadSeconds > 0) && ((mode == mode_multiple) || (mode == mode_daemon)))
+	{
+		printf("%sERROR: --loadtest can only be used with a single host.%s\n", COL_RED, RESET);
+		exit(0);
 	}
 
+	// Parallel workers write every host in one piece (set before any output)...
+	if ((mode == mode_multiple) && (workers > 1))
+		hostBuffer(stdout);
+
 	// Open XML file output...
 	if ((xmlArg > 0) && (mode != mode_help))
 	{
-		options.xmlOutput = fopen(argv[xmlArg] + 6, "w");
+		options.xmlOutput = openOutput(argv[xmlArg] + 6, compressLevel, (mode == mode_multiple) && (workers > 1));
 		if (options.xmlOutput == NULL)
 		{
 			printf("%sERROR: Could not open XML output file %s.%s\n", COL_RED, argv[xmlArg] + 6, RESET);
 			exit(0);
 		}
+		if ((mode == mode_multiple) && (workers > 1))
+			hostBuffer(options.xmlOutput);
 
 		// Output file header...
 		fprintf(options.xmlOutput, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<document title=\"SSLScan Results\" version=\"%s\" web=\"http://www.titania.co.uk\">\n", xml_version);
 	}
 
+	// Open trace file output...
+	if ((traceArg > 0) && (mode != mode_help))
+	{
+		options.traceOutput = openOutput(argv[traceArg] + 8, compressLevel, (mode == mode_multiple) && (workers > 1));
+		if (options.traceOutput == NULL)
+		{
+			printf("%sERROR: Could not open trace output file %s.%s\n", COL_RED, argv[traceArg] + 8, RESET);
+			exit(0);
+		}
+		fprintf(options.traceOutput, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"sslscan\"}}", (int)getpid());
+	}
+
+	// Load the baseline to compare with...
+	if ((baselineArg > 0) && ((mode == mode_single) || (mode == mode_multiple)) && (loadBaseline(argv[baselineArg] + 11) == false))
+		exit(0);
+
 	switch (mode)
 	{
 		case mode_version:
@@ -1787,8 +7745,38 @@ int main(int argc, char *argv[])
 			printf("  %s--targets=<file>%s     A file containing a list of hosts to\n", COL_GREEN, RESET);
 			printf("                       check.  Hosts can  be supplied  with\n");
 			printf("                       ports (i.e. host:port).\n");
+			printf("  %s--parallel=<n>%s       Scan the targets with n  processes\n", COL_GREEN, RESET);
+			printf("                       (hosts are shown as they complete).\n");
+			printf("  %s--sweep=<n>%s          Before the scan,  connect to n targets\n", COL_GREEN, RESET);
+			printf("                       at a time and send a ClientHello, only\n");
+			printf("                       the targets that answer with TLS are\n");
+			printf("                       scanned. Not with STARTTLS.\n");
 			printf("  %s--no-failed, -n%s      List only accepted ciphers  (default\n", COL_GREEN, RESET);
 			printf("                       is to list all ciphers).\n");
+			printf("  %s--cert-only%s          Only get the certificate,  with one\n", COL_GREEN, RESET);
+			printf("                       handshake per host,  and print one\n");
+			printf("                       line of metadata per host.\n");
+			printf("  %s--policy=<file>%s      Audit cipher classes instead of the\n", COL_GREEN, RESET);
+			printf("                       ciphers. One class per line:\n");
+			printf("                       <name> <OpenSSL ciphers> [protocol]\n");
+			printf("                       e.g. \"RC4 RC4\" or \"EXPORT EXP ssl3\".\n");
+			printf("                       A class fails if the server accepts\n");
+			printf("                       any of its ciphers.\n");
+			printf("  %s--loadtest=<s>%s       After the scan, make full handshakes\n", COL_GREEN, RESET);
+			printf("                       with every accepted cipher for s\n");
+			printf("                       seconds each and print handshakes/s,\n");
+			printf("                       latency percentiles and errors. One\n");
+			printf("                       host only, for servers you run.\n");
+			printf("  %s--load-connections=<n>%s Concurrent handshakes of the load\n", COL_GREEN, RESET);
+			printf("                       test (default %d).\n", loadtest_connections);
+			printf("  %s--load-rate=<n>%s      Handshakes per second of the  load\n", COL_GREEN, RESET);
+			printf("                       test (default as many as possible).\n");
+			printf("  %s--daemon=<socket>%s    Listen on a  Unix  socket  for  scan\n", COL_GREEN, RESET);
+			printf("                       jobs, one JSON object per line, e.g.\n");
+			printf("                       {\"id\":\"1\",\"target\":\"host:443\",\n");
+			printf("                        \"args\":[\"--tls1_2\"],\"xml\":false}\n");
+			printf("                       Ciphers, contexts,  client certifi-\n");
+			printf("                       cates and CAs stay loaded.\n");
 			printf("\n");
 			printf("Protocols:\n");
 			printf("  Any combination of:\n");
@@ -1796,14 +7784,15 @@ int main(int argc, char *argv[])
 			printf("  %s--ssl%s                Test all SSL protocols.\n", COL_GREEN, RESET);
 			printf("  %s--tls%s                Test all TLS protocols.\n", COL_GREEN, RESET);
 			printf("\n");
-#ifndef DISABLE_SSLv2
 			printf("  %s--ssl2%s               Test SSLv2 protocol.\n", COL_GREEN, RESET);
-#endif
 			printf("  %s--ssl3%s               Test SSLv3 protocol.\n", COL_GREEN, RESET);
 			printf("\n");
 			printf("  %s--tls1%s               Test TLSv1 protocol.\n", COL_GREEN, RESET);
 			printf("  %s--tls1_1%s             Test TLSv1.1 protocol.\n", COL_GREEN, RESET);
 			printf("  %s--tls1_2%s             Test TLSv1.2 protocol.\n", COL_GREEN, RESET);
+#ifdef TLS1_3_VERSION
+			printf("  %s--tls1_3%s             Test TLSv1.3 protocol.\n", COL_GREEN, RESET);
+#endif
 			printf("\n");
 			printf("Protocol options:\n");
 			printf("  %s--sni%s                Enable SNI and use the hostname as\n", COL_GREEN, RESET);
@@ -1814,10 +7803,18 @@ int main(int argc, char *argv[])
 			printf("  %s--ocsp-stapling, -o%s  Alias for --status-request.\n", COL_GREEN, RESET);
 			printf("  %s--bugs%s               Enable SSL implementation  bug work-\n", COL_GREEN, RESET);
 			printf("                       arounds.\n");
+			printf("  %s--source=<ip,..>%s     Connect from these local addresses,\n", COL_GREEN, RESET);
+			printf("                       in turn.\n");
+			printf("  %s--abortive-close%s     Reset connections when a probe  is\n", COL_GREEN, RESET);
+			printf("                       done  (no TIME_WAIT, for high probe\n");
+			printf("                       rates).\n");
 			printf("\n");
 			printf("Application layer protocols:\n");
 			printf("  %s--esmtps%s             SMTP: Use STARTTLS to initiate SSL.\n", COL_GREEN, RESET);
 			printf("  %s--starttls%s           Alias for --esmtps. Historic.\n", COL_GREEN, RESET);
+			printf("  %s--smtp-pipelining%s    SMTP: Send EHLO and STARTTLS in one\n", COL_GREEN, RESET);
+			printf("                       write once the server has advertised\n");
+			printf("                       PIPELINING.\n");
 			printf("  %s--pop3s%s              POP3: Use STLS to initiate SSL.\n", COL_GREEN, RESET);
 			printf("  %s--imaps%s              IMAP: Use STARTTLS to initiate SSL.\n", COL_GREEN, RESET);
 			printf("  %s--ftps%s               FTP: Use AUTH TLS to initiate SSL.\n", COL_GREEN, RESET);
@@ -1825,11 +7822,24 @@ int main(int argc, char *argv[])
 			printf("               	       support data channel ecnryption.\n");
 			printf("               	       (data channel is NOT initiated)\n");
 			printf("  %s--http%s               Test a HTTP connection.\n", COL_GREEN, RESET);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+			printf("  %s--groups%s             List the key exchange groups (curves,\n", COL_GREEN, RESET);
+			printf("                       FFDHE) the server accepts, in  order\n");
+			printf("                       of preference.\n");
+			printf("  %s--sigalgs%s            List the signature algorithms the\n", COL_GREEN, RESET);
+			printf("                       server accepts (TLSv1.2 and later).\n");
+			printf("  %s--resumption%s         Test  session  resumption  with\n", COL_GREEN, RESET);
+			printf("                       session IDs and tickets, and how\n");
+			printf("                       much faster a resumed handshake is.\n");
+#endif
 			printf("\n");
 			printf("Certificates:\n");
 			printf("  %s--cafile=<file>%s      A file containing the  trusted  cer-\n", COL_GREEN, RESET);
 			printf("                       tificates. Default is\n");
 			printf("                       %s.\n",options.cafile);
+			printf("  %s--capath=<dir>%s       A directory of  trusted certificates\n", COL_GREEN, RESET);
+			printf("                       (hashed  with  c_rehash),  used  in-\n");
+			printf("                       stead of the default file.\n");
 			printf("  %s--pk=<file>%s          A file containing the private key or\n", COL_GREEN, RESET);
 			printf("                       a PKCS#12  file containing a private\n");
 			printf("                       key/certificate pair (as produced by\n");
@@ -1841,6 +7851,27 @@ int main(int argc, char *argv[])
 			printf("\n");
 			printf("Output:\n");
 			printf("  %s--xml=<file>%s         Output results to an XML file.\n", COL_GREEN, RESET);
+			printf("  %s--quiet, -q%s          Do not print the results (errors are\n", COL_GREEN, RESET);
+			printf("                       still shown, --xml is still written).\n");
+			printf("  %s--baseline=<file>%s    Compare  with the  XML output  of an\n", COL_GREEN, RESET);
+			printf("                       earlier scan (may be .gz) and print\n");
+			printf("                       only what changed: accepted ciphers,\n");
+			printf("                       protocols, preferred ciphers and the\n");
+			printf("                       certificate, then a summary.\n");
+			printf("  %s--count%s              Print  one line per host  with the\n", COL_GREEN, RESET);
+			printf("                       number of accepted, rejected and\n");
+			printf("                       failed probes.\n");
+			printf("  %s--trace=<file>%s       Write a Chrome trace-event  timeline\n", COL_GREEN, RESET);
+			printf("                       of every probe to a JSON file.\n");
+			printf("  %s--metrics=<[ip:]port>%s Serve live Prometheus metrics over\n", COL_GREEN, RESET);
+			printf("                       HTTP (default address 127.0.0.1).\n");
+			printf("  %s--metrics-file=<file>%s Write Prometheus metrics to a file\n", COL_GREEN, RESET);
+			printf("                       (textfile collector format).\n");
+			printf("  %s--metrics-interval=<s>%s Metrics file update interval in\n", COL_GREEN, RESET);
+			printf("                       seconds (default 10).\n");
+			printf("  %s--compress-level=<n>%s Level of  output files that end in\n", COL_GREEN, RESET);
+			printf("                       .gz (1-9, default 6) or .zst (1-19,\n");
+			printf("                       default 3), which are compressed.\n");
 			printf("  %s-p%s                   Format results in pseudo wiki table.\n", COL_GREEN, RESET);
 			printf("  %s--version%s            Display the program version.\n", COL_GREEN, RESET);
 			printf("  %s--help%s               Display the  help text  you are  now\n", COL_GREEN, RESET);
@@ -1854,68 +7885,89 @@ int main(int argc, char *argv[])
 		// Check a single host/port ciphers...
 		case mode_single:
 		case mode_multiple:
-			printf("%s%s%s", COL_BLUE, program_version, RESET);
+		case mode_daemon:
+			if (textEnabled(&options) == true)
+				printf("%s%s%s", COL_BLUE, program_version, RESET);
 
-			SSLeay_add_all_algorithms();
-			ERR_load_crypto_strings();
+			// The daemon keeps the catalog of every protocol, jobs select from it...
+			if ((mode == mode_daemon) && (options.sslVersion == ssl_none))
+				options.sslVersion = ssl_tls_all;
 
 			// Build a list of ciphers...
-#ifndef DISABLE_SSLv2
-			if(options.sslVersion & ssl_v2) populateCipherList(&options, SSLv2_client_method()); 
-#endif
-			if(options.sslVersion & ssl_v3) populateCipherList(&options, SSLv3_client_method()); 
-			if(options.sslVersion & tls_v1) populateCipherList(&options, TLSv1_client_method()); 
-			if(options.sslVersion & tls_v1_1) populateCipherList(&options, TLSv1_1_client_method()); 
-			if(options.sslVersion & tls_v1_2) populateCipherList(&options, TLSv1_2_client_method()); 
+			populateCiphers(&options);
+
+			// Live metrics...
+			if ((metricsListen != 0) || (metricsFile != 0))
+			{
+				metricsPid = startMetrics(&options, metricsListen, metricsFile, metricsInterval);
+				if (metricsPid < 0)
+					exit(0);
+			}
 
 			// Do the testing...
 			if (mode == mode_single)
+			{
+				metricsAdd(&options, queueDepth, 1);
 				status = testHost(&options);
+				metricsAdd(&options, queueDepth, -1);
+				if (loadSeconds > 0)
+					status = loadTest(&options, loadSeconds, loadConnections, loadRate);
+			}
+			else if (mode == mode_daemon)
+				status = daemonLoop(&options, argv[daemonArg] + 9);
 			else
 			{
-				if (fileExists(argv[options.targets] + 10) == true)
+				targetsPath = argv[options.targets] + 10;
+				if (fileExists(targetsPath) == true)
 				{
-					// Open targets file...
-					targetsFile = fopen(argv[options.targets] + 10, "r");
-					if (targetsFile == NULL)
-						printf("%sERROR: Could not open targets file %s.%s\n", COL_RED, argv[options.targets] + 10, RESET);
-					else
+					// Count the targets for the queue depth...
+					if (options.metrics != 0)
 					{
-						readLine(targetsFile, line, sizeof(line));
-						while (feof(targetsFile) == 0)
+						targetsFile = fopen(argv[options.targets] + 10, "r");
+						if (targetsFile != NULL)
 						{
-							if (strlen(line) != 0)
+							while (fgets(line, sizeof(line), targetsFile) != NULL)
 							{
-								// Get host...
-								tempInt = 0;
-								while ((line[tempInt] != 0) && (line[tempInt] != ':'))
-									tempInt++;
-								line[tempInt] = 0;
-								strncpy(options.host, line, sizeof(options.host) -1);
-
-								// Get port (if it exists)...
-								tempInt++;
-								if (strlen(line + tempInt) > 0)
-									options.port = atoi(line + tempInt);
-
-								// Test the host...
-								status = testHost(&options);
+								if ((line[0] != '\r') && (line[0] != '\n'))
+									metricsAdd(&options, queueDepth, 1);
 							}
-							readLine(targetsFile, line, sizeof(line));
+							fclose(targetsFile);
 						}
 					}
+
+					// Sweep first, a batch needs a descriptor per target...
+					if ((sweepWidth > 0) && ((options.esmtps == true) || (options.pop3s == true) || (options.imaps == true) || (options.ftps == true)))
+						printf("%sERROR: --sweep can not be used with STARTTLS.%s\n", COL_RED, RESET);
+					else if (sweepWidth > 0)
+					{
+						if ((getrlimit(RLIMIT_NOFILE, &fileLimit) == 0) && (fileLimit.rlim_cur != RLIM_INFINITY) && (sweepWidth > (int)fileLimit.rlim_cur - 64))
+							sweepWidth = ((int)fileLimit.rlim_cur > 128) ? (int)fileLimit.rlim_cur - 64 : 64;
+						if (sweepTargets(&options, targetsPath, sweepWidth, sweptPath) == true)
+							targetsPath = sweptPath;
+					}
+
+					if (workers > 1)
+						status = scanTargetsParallel(&options, targetsPath, workers);
+					else
+						status = scanTargets(&options, targetsPath, 0);
+					if (targetsPath == sweptPath)
+						unlink(sweptPath);
 				}
 				else
-					printf("%sERROR: Targets file %s does not exist.%s\n", COL_RED, argv[options.targets] + 10, RESET);
+					printf("%sERROR: Targets file %s does not exist.%s\n", COL_RED, targetsPath, RESET);
 			}
 	
-			// Free Structures
-			while (options.ciphers != 0)
+			// Summary of the changes...
+			if (baseline != 0)
 			{
-				sslCipherPointer = options.ciphers->next;
-				free(options.ciphers);
-				options.ciphers = sslCipherPointer;
+				baselineSummary();
+				freeBaseline();
 			}
+
+			// Free Structures
+			stopMetrics(&options, metricsPid, metricsFile);
+			freeOptions(&options);
+			free(renderedCertificates);
 			break;
 	}
 
@@ -1926,6 +7978,13 @@ int main(int argc, char *argv[])
 		fclose(options.xmlOutput);
 	}
 
+	// Close trace file, if required...
+	if ((traceArg > 0) && (mode != mode_help))
+	{
+		fprintf(options.traceOutput, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		fclose(options.traceOutput);
+	}
+
 	return 0;
 }
-
+#endif
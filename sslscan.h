@@ -0,0 +1,255 @@
+/***************************************************************************
+ *   sslscan - A SSL cipher scanning tool                                  *
+ *   Copyright 2007-2009 by Ian Ventura-Whiting (Fizz)                     *
+ *   fizz@titania.co.uk                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program. If not, see <http://www.gnu.org/licenses/>.  *
+ *                                                                         *
+ *   The OpenSSL linking exception of sslscan.c applies to this file.      *
+ ***************************************************************************/
+
+/*
+ * libsslscan - the scanning core of sslscan as a library
+ *
+ * Every scan runs on a handle of its own (sslScanNew) and delivers its
+ * results through callbacks, nothing is printed. Handles share only the
+ * cipher catalog of the process, which is appended to under a lock and
+ * never changed, so a multi-threaded program can scan in parallel with
+ * one handle per thread. Memory a scan needs for itself is released when
+ * sslScanHost() returns. Call sslScanInit() once before the first handle is
+ * created; with OpenSSL before 1.1.0 the program also has to install the
+ * OpenSSL locking callbacks.
+ *
+ *	struct sslCheckOptions *scan = sslScanNew();
+ *	sslScanSetOption(scan, "--tls1_2");
+ *	sslScanSetCallbacks(scan, &callbacks, myData);
+ *	status = sslScanHost(scan, "www.example.com", 443);
+ *	sslScanFree(scan);
+ */
+
+#ifndef SSLSCAN_H
+#define SSLSCAN_H
+
+// Includes...
+#include <stdio.h>
+#include <netinet/in.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/ocsp.h>
+
+// Exported from the shared library (built with -fvisibility=hidden)
+#define SSLSCAN_API __attribute__((visibility("default")))
+
+// Bitmask for ssl versions
+#define ssl_none 0x00
+#define ssl_v2   0x01
+#define ssl_v3   0x02
+#define ssl_all  0x03 // 0x02+0x01
+#define tls_v1   0x04
+#define tls_v1_1 0x08
+#define tls_v1_2 0x10
+#define tls_v1_3 0x20
+#define tls_all  0x3c // 0x20+0x10+0x08+0x04
+#define ssl_tls_all  0xff
+
+// Probe status
+#define probe_accepted 1
+#define probe_rejected 0
+#define probe_failed -1
+
+// Failure classes of a probe, the transient ones are retried
+#define failure_none 0
+#define failure_timeout 1            // no answer in time
+#define failure_reset 2              // connection reset
+#define failure_local 3              // out of sockets, ports or memory
+#define failure_transient 3
+#define failure_alert 4              // the server sent a TLS alert
+#define failure_closed 5             // the server closed the connection
+#define failure_protocol 6           // no TLS (or STARTTLS) answer
+#define failure_network 7            // connection refused, host or network unreachable
+
+// Policy class result
+#define policy_pass 0
+#define policy_fail 1
+#define policy_untested 2
+#define policy_error 3
+
+// Key exchange parameters (--groups, --sigalgs)
+#define exchange_group 0
+#define exchange_signature 1
+
+// Session resumption methods (--resumption)
+#define resumption_session_id 0
+#define resumption_ticket 1
+
+// Probe phases (trace spans and latency histograms)
+#define phase_connect 0
+#define phase_starttls 1
+#define phase_handshake 2
+#define phase_http 3
+#define phase_certificate 4
+#define phase_host 5
+#define phase_count 6
+#define metrics_buckets 12
+
+
+// Scan handle (opaque)...
+struct sslCheckOptions;
+
+// Scan metrics, updated with atomic adds (may be shared by handles)...
+struct scanMetrics
+{
+	long probesStarted;
+	long probesAccepted;
+	long probesRejected;
+	long probesFailed;
+	long probesTimedOut;
+	long probesRetried;
+	long handshakes;
+	long connectionsInFlight;
+	long queueDepth;
+	long phaseCount[phase_count];
+	long phaseSum[phase_count];
+	long phaseBuckets[phase_count][metrics_buckets];
+
+	// Previous exposition, for the handshake rate...
+	long rateHandshakes;
+	long long rateTime;
+};
+
+// Result of a cipher probe or of a preferred cipher test...
+struct sslCipherResult
+{
+	int status;                  // probe_accepted, probe_rejected or probe_failed
+	int sslVersion;              // ssl_v2 ... tls_v1_3
+	const char *version;         // "SSLv3", "TLSv1.2", ...
+	const char *cipher;
+	int bits;
+	const char *httpStatus;      // --http: status of the response (0 if none)
+	const char *dataChannel;     // --ftps-dcs: reply code to PROT P (0 if none)
+	unsigned long cipherId;      // SSL_CIPHER_get_id()
+	int httpCode;                // --http: numeric status (0 if none)
+	long connectTime;            // microseconds for TCP connect and STARTTLS
+	long handshakeTime;          // microseconds for the handshake
+	int failure;                 // failure_* class of a failed probe
+	const char *alert;           // TLS alert received (0 if none)
+	int retries;                 // attempts before this result
+};
+
+// The certificate of a host (valid during the callback only)...
+struct sslCertificateResult
+{
+	X509 *certificate;           // 0 if the server did not send one
+	long verifyResult;           // X509_V_OK if it passed verification
+	int statusRequested;         // --status-request was set
+	int ocspStapled;             // the server stapled an OCSP response...
+	OCSP_RESPONSE *ocspResponse; // ...parsed (0 if it could not be parsed)
+};
+
+// Result of a cipher class of the --policy file...
+struct sslPolicyResult
+{
+	const char *policyClass;     // name of the class
+	int status;                  // policy_pass, policy_fail, policy_untested or policy_error
+	const char *version;         // protocol of the first accepted cipher (0 if none)
+	const char *ciphers;         // accepted ciphers, ':' separated ("" if none)
+	int handshakes;              // handshakes used for the class
+};
+
+// A key exchange group or signature algorithm the server accepted...
+//   Reported in the order the server picked them, most preferred first.
+struct sslExchangeResult
+{
+	int kind;                    // exchange_group or exchange_signature
+	int sslVersion;              // tls_v1 ... tls_v1_3
+	const char *version;         // "TLSv1.2", ...
+	const char *name;            // "X25519", "P-256", "RSA-PSS+SHA256", "ed25519", ...
+	int bits;                    // of the group's key (0 for signature algorithms)
+	const char *cipher;          // cipher of the handshakes
+};
+
+// Session resumption with a protocol, tested with pairs of a full handshake
+// and one that offers the session it gave...
+struct sslResumptionResult
+{
+	int method;                  // resumption_session_id or resumption_ticket
+	int sslVersion;              // tls_v1 ... tls_v1_3
+	const char *version;         // "TLSv1.2", ...
+	const char *cipher;          // cipher of the full handshakes (0 if none)
+	int resumed;                 // the server resumed the session
+	long ticketLifetime;         // lifetime hint of the ticket in seconds (-1 if none)
+	long fullTime;               // median microseconds of a full handshake
+	long resumedTime;            // median microseconds of a resumed handshake (0 if none)
+};
+
+// Result callbacks, any of them may be 0...
+struct sslScanCallbacks
+{
+	void (*hostStart)(void *userData, const char *host, int port);
+	void (*cipher)(void *userData, const struct sslCipherResult *result);
+	void (*preferredStart)(void *userData);
+	void (*preferred)(void *userData, const struct sslCipherResult *result);
+	void (*certificate)(void *userData, const struct sslCertificateResult *result);
+	void (*hostEnd)(void *userData, const char *host, int port, int status);
+	void (*error)(void *userData, const char *message);
+	void (*policy)(void *userData, const struct sslPolicyResult *result);
+	void (*exchange)(void *userData, const struct sslExchangeResult *result);
+	void (*resumption)(void *userData, const struct sslResumptionResult *result);
+};
+
+
+// Initialise OpenSSL, once per process...
+SSLSCAN_API void sslScanInit(void);
+
+// Create a scan handle (default port 443, no protocols selected)...
+SSLSCAN_API struct sslCheckOptions *sslScanNew(void);
+
+// Set an option, using the command line syntax ("--tls1_2", "--sni=name",
+// "--cafile=file", "--policy=file", ...). Returns 0 if the option is
+// unknown or could not be applied...
+SSLSCAN_API int sslScanSetOption(struct sslCheckOptions *options, const char *option);
+
+// Use a trust store of the caller instead of loading --cafile/--capath,
+// so that many handles share one parsed set of CAs (0 to go back to the
+// options). The handle takes a reference of its own...
+SSLSCAN_API void sslScanSetTrustStore(struct sslCheckOptions *options, X509_STORE *store);
+
+// Set the result callbacks, userData is passed to every callback...
+SSLSCAN_API void sslScanSetCallbacks(struct sslCheckOptions *options, const struct sslScanCallbacks *callbacks, void *userData);
+
+// Write Chrome trace events to a file (0 to stop). Every event is written
+// as ",\n{...}", the caller writes the enclosing array and its first event...
+SSLSCAN_API void sslScanSetTrace(struct sslCheckOptions *options, FILE *traceOutput);
+
+// Count probes and phase latencies in metrics (0 to stop)...
+SSLSCAN_API void sslScanSetMetrics(struct sslCheckOptions *options, struct scanMetrics *metrics);
+
+// Scan a host, a port of 0 keeps the default of the options. A probe that
+// fails is retried if the failure is transient, then the scan goes on.
+// TLS 1.3 suites are found by elimination, they are reported in the order
+// the server picked them, followed by the ones it rejected.
+// Returns 1 if every probe could be run...
+SSLSCAN_API int sslScanHost(struct sslCheckOptions *options, const char *host, int port);
+
+// Sweep endpoints in one batch: connect, send a ClientHello and read the
+// first bytes of the reply. answered[i] is set to 1 if endpoint i answered
+// with TLS (a handshake or an alert). Uses io_uring if built with
+// WITH_IO_URING and the kernel supports it, else epoll. Returns 0 if the
+// sweep could not be run...
+SSLSCAN_API int sslScanSweep(struct sslCheckOptions *options, const struct sockaddr_in *addresses, int count, char *answered);
+
+// Free a scan handle...
+SSLSCAN_API void sslScanFree(struct sslCheckOptions *options);
+
+#endif